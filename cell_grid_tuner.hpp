@@ -0,0 +1,346 @@
+#pragma once
+
+#include <random>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <iomanip>
+
+#include <Kokkos_Core.hpp>
+
+#include <molecule_container.hpp>
+#include <index_converter.hpp>
+
+// occupancy of the linked cells, histogram[k] = number of cells holding k molecules
+struct OccupancyStatistics
+{
+    std::vector<int> histogram;
+    int maxOccupancy = 0;
+    int p99Occupancy = 0;
+    // upper bound a cell can reach while a sort is still moving molecules, at least maxOccupancy
+    int peakOccupancy = 0;
+    double meanOccupancy = 0;
+
+    std::string to_string() const
+    {
+        std::stringstream to_ret;
+        to_ret << "mean: " << meanOccupancy << " p99: " << p99Occupancy << " max: " << maxOccupancy << " peak: " << peakOccupancy << std::endl;
+        to_ret << "histogram:";
+        for (size_t k = 0; k < histogram.size(); k++)
+            to_ret << " " << k << ":" << histogram[k];
+        return to_ret.str();
+    }
+};
+
+// cell grid resolution and capacity, persisted between runs as "key value" lines together with the system they were tuned for
+struct CellGridSettings
+{
+    int numCellsPerDim = 0;
+    int cellSize = 0;
+    double capacityFactor = 0;
+    // system the grid was tuned for, a grid only satisfies the cutoff and divisibility constraints of its own system
+    int domainSize = 0;
+    double cutoff = 0;
+    int numMolecules = 0;
+
+    // settings without an admissible grid are not written
+    bool save(const std::string& fileName) const
+    {
+        if(numCellsPerDim <= 0 || cellSize <= 0)
+            return false;
+        std::ofstream file(fileName);
+        if(!file)
+            return false;
+        file << std::setprecision(17);
+        file << "numCellsPerDim " << numCellsPerDim << std::endl;
+        file << "cellSize " << cellSize << std::endl;
+        file << "capacityFactor " << capacityFactor << std::endl;
+        file << "domainSize " << domainSize << std::endl;
+        file << "cutoff " << cutoff << std::endl;
+        file << "numMolecules " << numMolecules << std::endl;
+        return true;
+    }
+
+    // fails if the file is missing or malformed, or if it was tuned for another domain size, cutoff or number of molecules
+    bool load(const std::string& fileName, int expectedDomainSize, double expectedCutoff, int expectedNumMolecules)
+    {
+        std::ifstream file(fileName);
+        if(!file)
+            return false;
+        CellGridSettings loaded;
+        std::string key;
+        while (file >> key)
+        {
+            if(key == "numCellsPerDim") file >> loaded.numCellsPerDim;
+            else if(key == "cellSize") file >> loaded.cellSize;
+            else if(key == "capacityFactor") file >> loaded.capacityFactor;
+            else if(key == "domainSize") file >> loaded.domainSize;
+            else if(key == "cutoff") file >> loaded.cutoff;
+            else if(key == "numMolecules") file >> loaded.numMolecules;
+            else return false;
+        }
+        if(loaded.numCellsPerDim <= 0 || loaded.cellSize <= 0)
+            return false;
+        if(loaded.domainSize != expectedDomainSize || loaded.numMolecules != expectedNumMolecules || std::abs(loaded.cutoff - expectedCutoff) > 1e-12 * std::abs(expectedCutoff))
+            return false;
+        *this = loaded;
+        return true;
+    }
+
+    std::string to_string() const
+    {
+        std::stringstream to_ret;
+        to_ret << "numCellsPerDim: " << numCellsPerDim << " cellSize: " << cellSize << " capacityFactor: " << capacityFactor;
+        return to_ret.str();
+    }
+};
+
+class CellGridTuner
+{
+public:
+    // stepDisplacement is how far molecules move between two sorts in the trials, below the cutoff and thus below every candidate cell width
+    CellGridTuner(int domainSize, double cutoff, std::mt19937 gen, std::uniform_int_distribution<> dis, double stepDisplacement = 0) : _domainSize(domainSize), _cutoff(cutoff),
+        _stepDisplacement(stepDisplacement > 0 ? stepDisplacement : 0.1 * cutoff), _gen(gen), _dis(dis), _capacityFactors({1.0, 1.1, 1.25, 1.5, 2.0, 3.0}), _trialRuns(3), _timeTolerance(0.05)
+    {
+        assert(_stepDisplacement < cutoff);
+    }
+
+    static OccupancyStatistics gatherOccupancy(const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>& linkedCellNumMolecules)
+    {
+        OccupancyStatistics stats;
+        const int numCells = linkedCellNumMolecules.extent(0);
+        int maxOccupancy = 0;
+        long totalMolecules = 0;
+        Kokkos::parallel_reduce(numCells, KOKKOS_LAMBDA(const int i, int& localMax) {
+            if(linkedCellNumMolecules(i) > localMax) localMax = linkedCellNumMolecules(i);
+        }, Kokkos::Max<int>(maxOccupancy));
+        Kokkos::parallel_reduce(numCells, KOKKOS_LAMBDA(const int i, long& localSum) {
+            localSum += linkedCellNumMolecules(i);
+        }, totalMolecules);
+
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> histogram("occupancyHistogram", maxOccupancy + 1);
+        Kokkos::parallel_for(numCells, KOKKOS_LAMBDA(const int i) {
+            Kokkos::atomic_increment(&histogram(linkedCellNumMolecules(i)));
+        });
+        Kokkos::fence();
+
+        stats.maxOccupancy = maxOccupancy;
+        stats.peakOccupancy = maxOccupancy;
+        stats.meanOccupancy = numCells > 0 ? static_cast<double>(totalMolecules) / numCells : 0;
+        stats.histogram.resize(maxOccupancy + 1);
+        int cumulative = 0;
+        bool p99Found = false;
+        for (int k = 0; k <= maxOccupancy; k++)
+        {
+            stats.histogram[k] = histogram(k);
+            cumulative += histogram(k);
+            if(!p99Found && cumulative >= 0.99 * numCells)
+            {
+                stats.p99Occupancy = k;
+                p99Found = true;
+            }
+        }
+        return stats;
+    }
+
+    // occupancy the cells would have after the next sort, computed without moving any molecule
+    static OccupancyStatistics projectOccupancy(const MoleculeContainer& container, const IndexConverter& indexConverter)
+    {
+        auto moleculeData(container.moleculeData);
+        auto linkedCellNumMolecules(container.linkedCellNumMolecules);
+        // Molecule::pos is stale while quantised positions are enabled
+        const QuantisedPositions quantised = container.quantisedPositions;
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> targetNumMolecules("targetNumMolecules", container.getNumCells());
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> incomingMolecules("incomingMolecules", container.getNumCells());
+        Kokkos::parallel_for(container.getNumCells(), KOKKOS_LAMBDA(const int i) {
+            for (int j = 0; j < linkedCellNumMolecules(i); j++)
+            {
+                double pos[3];
+                quantised.read(moleculeData, i, j, pos);
+                // sort wraps positions of periodic containers before binning them
+                if(indexConverter.isPeriodic()) indexConverter.wrap(pos);
+                int target = indexConverter.getIndex(pos);
+                Kokkos::atomic_increment(&targetNumMolecules(target));
+                if(target != i) Kokkos::atomic_increment(&incomingMolecules(target));
+            }
+        });
+        Kokkos::fence();
+        OccupancyStatistics stats = gatherOccupancy(targetNumMolecules);
+        // sort may fill a cell with incoming molecules before its own leavers are gone
+        int peakOccupancy = 0;
+        Kokkos::parallel_reduce(container.getNumCells(), KOKKOS_LAMBDA(const int i, int& localMax) {
+            if(linkedCellNumMolecules(i) + incomingMolecules(i) > localMax) localMax = linkedCellNumMolecules(i) + incomingMolecules(i);
+        }, Kokkos::Max<int>(peakOccupancy));
+        stats.peakOccupancy = std::max(stats.maxOccupancy, peakOccupancy);
+        return stats;
+    }
+
+    // tunes for the molecules of the live container: every admissible grid gets a copy of them, displaced by one step,
+    // whose projected occupancy bounds the capacities tried, and the sort of that step is timed on the copy for every capacity,
+    // the fastest grid and capacity wins and among equally fast the smallest, numCellsPerDim stays 0 if no grid is admissible
+    CellGridSettings tune(const MoleculeContainer& live, bool display = false)
+    {
+        const std::vector<Molecule> molecules = liveMolecules(live);
+        const bool periodic = live.getHaloWidth() > 0;
+        CellGridSettings best;
+        best.domainSize = _domainSize;
+        best.cutoff = _cutoff;
+        best.numMolecules = molecules.size();
+        if(display)
+            std::cout << "live occupancy on " << live.getNumCellsPerDim() << " cells per dimension " << gatherOccupancy(live.linkedCellNumMolecules).to_string() << std::endl;
+
+        double bestTime = std::numeric_limits<double>::max();
+        std::vector<Trial> trials;
+        for (int numCellsPerDim = 1; _domainSize / numCellsPerDim >= _cutoff; numCellsPerDim++)
+        {
+            // the index converter works with whole cell widths, periodic grids need whole colour strides
+            if(_domainSize % numCellsPerDim != 0 || (periodic && numCellsPerDim % 2 != 0))
+                continue;
+            const int numCells = numCellsPerDim * numCellsPerDim * numCellsPerDim;
+            IndexConverter indexConverter(_domainSize, numCellsPerDim, periodic ? 1 : 0);
+
+            MoleculeContainer probe = copyOnto(molecules, numCellsPerDim, indexConverter);
+            displace(probe, indexConverter);
+            OccupancyStatistics stats = projectOccupancy(probe, indexConverter);
+            if(display)
+                std::cout << "numCellsPerDim " << numCellsPerDim << " projected occupancy " << stats.to_string() << std::endl;
+
+            int lastCellSize = -1;
+            for (double capacityFactor : _capacityFactors)
+            {
+                const int cellSize = std::max({static_cast<int>(std::ceil(capacityFactor * stats.p99Occupancy)), stats.peakOccupancy, 1});
+                // factors that do not change the capacity need no second trial
+                if(cellSize == lastCellSize)
+                    continue;
+                lastCellSize = cellSize;
+
+                Trial trial = {numCellsPerDim, cellSize, timeTrial(molecules, numCellsPerDim, cellSize, indexConverter),
+                    static_cast<size_t>(numCells) * (cellSize * sizeof(Molecule) + sizeof(int)), cellSize / std::max(stats.meanOccupancy, 1.0)};
+                if(display)
+                    std::cout << "  cellSize " << cellSize << ": " << trial.time << " us, " << trial.bytes << " bytes" << std::endl;
+                bestTime = std::min(bestTime, trial.time);
+                trials.push_back(trial);
+            }
+        }
+
+        size_t bestBytes = std::numeric_limits<size_t>::max();
+        for (const Trial& trial : trials)
+        {
+            if(trial.time <= bestTime * (1 + _timeTolerance) && trial.bytes < bestBytes)
+            {
+                bestBytes = trial.bytes;
+                best.numCellsPerDim = trial.numCellsPerDim;
+                best.cellSize = trial.cellSize;
+                best.capacityFactor = trial.capacityFactor;
+            }
+        }
+        if(display)
+            std::cout << "Chosen settings: " << best.to_string() << std::endl;
+        return best;
+    }
+
+    void setCapacityFactors(const std::vector<double>& capacityFactors) { _capacityFactors = capacityFactors; }
+    void setTrialRuns(int trialRuns) { _trialRuns = trialRuns; }
+    void setTimeTolerance(double timeTolerance) { _timeTolerance = timeTolerance; }
+
+private:
+    struct Trial
+    {
+        int numCellsPerDim;
+        int cellSize;
+        double time;
+        size_t bytes;
+        double capacityFactor;
+    };
+
+    // interior molecules of the live container with their current positions, also while quantised positions are enabled
+    static std::vector<Molecule> liveMolecules(const MoleculeContainer& live)
+    {
+        std::vector<Molecule> molecules;
+        for (int i = 0; i < live.getNumCells(); i++)
+        {
+            if(live.isHaloCell(i))
+                continue;
+            for (int j = 0; j < live.linkedCellNumMolecules(i); j++)
+            {
+                Molecule m = live.moleculeData(i, j);
+                live.getPosition(i, j, m.pos);
+                molecules.push_back(m);
+            }
+        }
+        return molecules;
+    }
+
+    // a container of the candidate grid holding the molecules in their cells, with room for at least cellSize per cell
+    MoleculeContainer copyOnto(const std::vector<Molecule>& molecules, int numCellsPerDim, const IndexConverter& indexConverter, int cellSize = 1) const
+    {
+        MoleculeContainer copy(numCellsPerDim, 1, _gen, _dis, MoleculeContainerOptions().setPeriodic(indexConverter.isPeriodic()));
+        std::vector<int> occupancy(copy.getNumCells(), 0);
+        std::vector<int> targets;
+        for (const Molecule& m : molecules)
+        {
+            double pos[3] = {m.pos[0], m.pos[1], m.pos[2]};
+            if(indexConverter.isPeriodic()) indexConverter.wrap(pos);
+            targets.push_back(indexConverter.getIndex(pos));
+            occupancy[targets.back()]++;
+        }
+        copy.reserve(std::max(cellSize, *std::max_element(occupancy.begin(), occupancy.end())));
+        for (size_t k = 0; k < molecules.size(); k++)
+        {
+            Molecule m = molecules[k];
+            copy.insert(targets[k], m);
+        }
+        return copy;
+    }
+
+    // moves every molecule by less than _stepDisplacement along every dimension, non-periodic copies keep their molecules inside the domain
+    void displace(MoleculeContainer& container, const IndexConverter& indexConverter) const
+    {
+        for (int i = 0; i < container.getNumCells(); i++)
+        {
+            if(container.isHaloCell(i))
+                continue;
+            for (int j = 0; j < container.linkedCellNumMolecules(i); j++)
+            {
+                Molecule& m = container.moleculeData(i, j);
+                for (int d = 0; d < 3; d++)
+                {
+                    m.pos[d] += _stepDisplacement * std::sin(m.id + 3.0 * d);
+                    if(!indexConverter.isPeriodic())
+                        m.pos[d] = std::min(std::max(m.pos[d], 0.0), _domainSize - 1e-9);
+                }
+            }
+        }
+    }
+
+    // best of _trialRuns sorts of one step on copies of the live molecules, copying and displacing are not timed
+    double timeTrial(const std::vector<Molecule>& molecules, int numCellsPerDim, int cellSize, const IndexConverter& indexConverter) const
+    {
+        double bestTime = std::numeric_limits<double>::max();
+        for (int run = 0; run < _trialRuns; run++)
+        {
+            MoleculeContainer container = copyOnto(molecules, numCellsPerDim, indexConverter, cellSize);
+            displace(container, indexConverter);
+            auto t1 = std::chrono::high_resolution_clock::now();
+            container.sort(indexConverter);
+            auto t2 = std::chrono::high_resolution_clock::now();
+            bestTime = std::min(bestTime, static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count()));
+        }
+        return bestTime;
+    }
+
+    int _domainSize;
+    double _cutoff;
+    double _stepDisplacement;
+    std::mt19937 _gen;
+    std::uniform_int_distribution<> _dis;
+    std::vector<double> _capacityFactors;
+    int _trialRuns;
+    double _timeTolerance;
+};
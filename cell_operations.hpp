@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+// per-cell bodies of sort and compact, shared by MoleculeContainer and MoleculeEnsemble
+// Cells gives access to one grid of cells and is notified of every move, so that containers can keep side data in step:
+//   int& count(cell), Molecule& at(cell, slot)
+//   int target(cell, slot, pos)         reads the position of (cell, slot) into pos and returns the cell it belongs to
+//   void placed(cell, slot, pos)        the molecule now in (cell, slot) arrived there from another cell, pos is its position
+//   void copied(cell, from, to)         the molecule in slot from of cell was copied into slot to of the same cell
+//   void relocated(cell, slot)          the molecule now in (cell, slot) came there from another slot of the same cell
+struct CellOperations
+{
+    // moves the molecule in (cell, slot) to the end of target and fills its slot with the last molecule of cell
+    // the append is atomic, so cells sorted at the same time may move molecules into the same target, as long as no target is
+    // itself being sorted at that time
+    template<class Cells>
+    KOKKOS_INLINE_FUNCTION static void moveToCell(const Cells& cells, int cell, int slot, int target, const double pos[3])
+    {
+        const int targetSlot = Kokkos::atomic_fetch_add(&cells.count(target), 1);
+        cells.at(target, targetSlot) = cells.at(cell, slot);
+        cells.placed(target, targetSlot, pos);
+        removeSlot(cells, cell, slot);
+    }
+
+    // swap-with-last, does not keep order
+    template<class Cells>
+    KOKKOS_INLINE_FUNCTION static void removeSlot(const Cells& cells, int cell, int slot)
+    {
+        const int last = cells.count(cell) - 1;
+        cells.at(cell, slot) = cells.at(cell, last);
+        cells.copied(cell, last, slot);
+        cells.count(cell) = last;
+        if(slot < last) cells.relocated(cell, slot);
+    }
+
+    // moves every molecule of cell that left it
+    template<class Cells>
+    KOKKOS_INLINE_FUNCTION static void sortCell(const Cells& cells, int cell)
+    {
+        for (int i = 0; i < cells.count(cell); i++)
+        {
+            double pos[3];
+            const int target = cells.target(cell, i, pos);
+            if(target != cell)
+            {
+                moveToCell(cells, cell, i, target, pos);
+                // the molecule at position i is now new
+                i--;
+            }
+        }
+    }
+
+    // removes the dirty molecules of cell
+    template<class Cells>
+    KOKKOS_INLINE_FUNCTION static void compactCell(const Cells& cells, int cell)
+    {
+        int j = 0;
+        while (j < cells.count(cell))
+        {
+            if(cells.at(cell, j).dirty)
+                removeSlot(cells, cell, j);
+            else
+                j++;
+        }
+    }
+
+    // removes the dirty molecules of cell and shifts the others forward, keeps order
+    template<class Cells>
+    KOKKOS_INLINE_FUNCTION static void compactCellKeepingOrder(const Cells& cells, int cell)
+    {
+        int kept = 0;
+        for (int j = 0; j < cells.count(cell); j++)
+        {
+            if(cells.at(cell, j).dirty)
+                continue;
+            if(kept < j)
+            {
+                cells.at(cell, kept) = cells.at(cell, j);
+                cells.copied(cell, j, kept);
+                cells.relocated(cell, kept);
+            }
+            kept++;
+        }
+        cells.count(cell) = kept;
+    }
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <Kokkos_Core.hpp>
+
+// neighbour cell offsets that can hold molecules within the cutoff of a cell, for cells narrower than the cutoff
+// with an edge of cutoff/k the offsets span k cells along every dimension, offsets whose closest points are
+// at least a cutoff apart are pruned, so corners of the (2k+1)^3 block are dropped for k >= 3
+// the half shell keeps one offset of every +-pair, (0,0,0) first, so that every cell pair is visited once
+class CellStencil
+{
+public:
+    CellStencil(double cellWidth, double cutoff, bool halfShell = true) : _reach(1), _halfShell(halfShell)
+    {
+        while (_reach * cellWidth < cutoff)
+            _reach++;
+        std::vector<int> selected = {0, 0, 0};
+        for (int dz = -_reach; dz <= _reach; dz++)
+        {
+            for (int dy = -_reach; dy <= _reach; dy++)
+            {
+                for (int dx = -_reach; dx <= _reach; dx++)
+                {
+                    if(dx == 0 && dy == 0 && dz == 0)
+                        continue;
+                    if(halfShell && (dz < 0 || (dz == 0 && (dy < 0 || (dy == 0 && dx < 0)))))
+                        continue;
+                    if(minimumDistance2(dx, dy, dz, cellWidth) >= cutoff * cutoff)
+                        continue;
+                    selected.push_back(dx);
+                    selected.push_back(dy);
+                    selected.push_back(dz);
+                }
+            }
+        }
+        offsets = Kokkos::View<int*[3], Kokkos::LayoutRight, Kokkos::SharedSpace>("stencilOffsets", selected.size() / 3);
+        for (size_t i = 0; i < selected.size() / 3; i++)
+            for (int d = 0; d < 3; d++)
+                offsets(i, d) = selected[3 * i + d];
+    }
+
+    // squared distance between the closest points of two cells that are (dx, dy, dz) cells apart
+    static double minimumDistance2(int dx, int dy, int dz, double cellWidth)
+    {
+        const double gap[3] = {std::max(std::abs(dx) - 1, 0) * cellWidth, std::max(std::abs(dy) - 1, 0) * cellWidth, std::max(std::abs(dz) - 1, 0) * cellWidth};
+        return gap[0] * gap[0] + gap[1] * gap[1] + gap[2] * gap[2];
+    }
+
+    // number of cells the stencil extends along every dimension, also the halo width a periodic container needs
+    int reach() const { return _reach; }
+    bool isHalfShell() const { return _halfShell; }
+    int size() const { return offsets.extent(0); }
+
+    // stride of a colouring along dimension d in which cells of one colour never share a cell of their stencils
+    // a half shell only reaches forward in z, so k+1 suffices there
+    int colourStride(int d) const
+    {
+        return (_halfShell && d == 2) ? _reach + 1 : 2 * _reach + 1;
+    }
+    int numColours() const { return colourStride(0) * colourStride(1) * colourStride(2); }
+
+    Kokkos::View<int*[3], Kokkos::LayoutRight, Kokkos::SharedSpace> offsets;
+
+private:
+    int _reach;
+    bool _halfShell;
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <Kokkos_Core.hpp>
+
+#include <cell_stencil.hpp>
+
+struct CellTaskStatistics
+{
+    // tasks put back because a cell of their neighbourhood was busy, and tasks that had to wait for their neighbourhood
+    long deferred = 0;
+    long blocked = 0;
+
+    std::string to_string() const
+    {
+        return "deferred " + std::to_string(deferred) + ", blocked " + std::to_string(blocked);
+    }
+};
+
+// runs one task per cell without barriers between colours: a worker takes the next cell from a shared ticket counter and
+// claims every cell the task touches through a per-cell ownership flag, so no two tasks that share a cell run at the same time
+// a neighbourhood that is busy is released again and the task deferred to a small per-worker queue, which is retried before every
+// new ticket, when the queue is full or the tickets are exhausted a worker waits for its oldest deferred task instead
+// flags are claimed in ascending cell order, so waiting workers never form a cycle
+// tickets follow a conflict-free colouring, consecutive tickets therefore rarely collide, but a slow cell only delays its own neighbours
+// workers are host threads, spinning on flags needs independent forward progress which device threads do not guarantee
+class CellTaskScheduler
+{
+public:
+    using ExecutionSpace = Kokkos::DefaultHostExecutionSpace;
+    using WorkerPolicy = Kokkos::RangePolicy<ExecutionSpace, Kokkos::Schedule<Kokkos::Static>>;
+    static constexpr int maxDeferred = 8;
+
+    // tasks[t] is the cell task t works on, lockSets[t] every cell it reads or writes, numCells the size of the whole grid
+    CellTaskScheduler(const std::vector<int>& tasks, const std::vector<std::vector<int>>& lockSets, int numCells, int numWorkers = ExecutionSpace().concurrency())
+        : _numWorkers(numWorkers), _tasks("cellTasks", tasks.size()), _lockSetOffsets("cellTaskLockSetOffsets", tasks.size() + 1),
+        _owners("cellOwners", numCells), _taskOfCell("cellTaskOfCell", numCells), _counters("cellTaskCounters", 3)
+    {
+        Kokkos::deep_copy(_taskOfCell, -1);
+        std::vector<int> flattened;
+        for (size_t t = 0; t < tasks.size(); t++)
+        {
+            std::vector<int> sorted(lockSets[t]);
+            std::sort(sorted.begin(), sorted.end());
+            sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+            _tasks(t) = tasks[t];
+            _taskOfCell(tasks[t]) = t;
+            _lockSetOffsets(t) = flattened.size();
+            flattened.insert(flattened.end(), sorted.begin(), sorted.end());
+        }
+        _lockSetOffsets(tasks.size()) = flattened.size();
+        _lockSets = Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::HostSpace>("cellTaskLockSets", flattened.size());
+        for (size_t k = 0; k < flattened.size(); k++)
+            _lockSets(k) = flattened[k];
+    }
+
+    // interior cells of a container that sorts molecules moving at most reach cells, each task owns the cells within reach,
+    // wrapped into the interior for periodic containers (haloWidth > 0) where sort wraps positions
+    static CellTaskScheduler forSort(int numCellsPerDim, int haloWidth, int reach = 1)
+    {
+        const int numCellsPerDimWithHalo = numCellsPerDim + 2 * haloWidth;
+        std::vector<int> tasks;
+        std::vector<std::vector<int>> lockSets;
+        const int stride[3] = {2 * reach + 1, 2 * reach + 1, 2 * reach + 1};
+        forEachInteriorCell(numCellsPerDim, haloWidth, stride, [&](const int c[3]) {
+            std::vector<int> lockSet;
+            for (int dz = -reach; dz <= reach; dz++)
+            {
+                for (int dy = -reach; dy <= reach; dy++)
+                {
+                    for (int dx = -reach; dx <= reach; dx++)
+                    {
+                        int n[3] = {c[0] + dx, c[1] + dy, c[2] + dz};
+                        bool outside = false;
+                        for (int d = 0; d < 3; d++)
+                        {
+                            if(haloWidth > 0)
+                                n[d] = haloWidth + ((n[d] - haloWidth) % numCellsPerDim + numCellsPerDim) % numCellsPerDim;
+                            else
+                                outside = outside || n[d] < 0 || n[d] >= numCellsPerDim;
+                        }
+                        if(!outside)
+                            lockSet.push_back(n[0] + n[1] * numCellsPerDimWithHalo + n[2] * numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+                    }
+                }
+            }
+            tasks.push_back(c[0] + c[1] * numCellsPerDimWithHalo + c[2] * numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+            lockSets.push_back(lockSet);
+        });
+        return CellTaskScheduler(tasks, lockSets, numCellsPerDimWithHalo * numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+    }
+
+    // interior cells of a pair traversal over stencil, each task owns its cell and the cells its stencil offsets reach,
+    // ghost cells included, offsets leaving a container without halo are dropped
+    static CellTaskScheduler forStencil(int numCellsPerDim, int haloWidth, const CellStencil& stencil)
+    {
+        const int numCellsPerDimWithHalo = numCellsPerDim + 2 * haloWidth;
+        std::vector<int> tasks;
+        std::vector<std::vector<int>> lockSets;
+        const int stride[3] = {stencil.colourStride(0), stencil.colourStride(1), stencil.colourStride(2)};
+        forEachInteriorCell(numCellsPerDim, haloWidth, stride, [&](const int c[3]) {
+            std::vector<int> lockSet;
+            for (int s = 0; s < stencil.size(); s++)
+            {
+                const int n[3] = {c[0] + stencil.offsets(s, 0), c[1] + stencil.offsets(s, 1), c[2] + stencil.offsets(s, 2)};
+                if(n[0] < 0 || n[1] < 0 || n[2] < 0 || n[0] >= numCellsPerDimWithHalo || n[1] >= numCellsPerDimWithHalo || n[2] >= numCellsPerDimWithHalo)
+                    continue;
+                lockSet.push_back(n[0] + n[1] * numCellsPerDimWithHalo + n[2] * numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+            }
+            tasks.push_back(c[0] + c[1] * numCellsPerDimWithHalo + c[2] * numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+            lockSets.push_back(lockSet);
+        });
+        return CellTaskScheduler(tasks, lockSets, numCellsPerDimWithHalo * numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+    }
+
+    int numTasks() const { return _tasks.extent(0); }
+
+    // whether the task of cell holds other while it runs, false for cells without a task
+    bool locks(int cell, int other) const
+    {
+        const int t = _taskOfCell(cell);
+        if(t < 0)
+            return false;
+        return std::binary_search(_lockSets.data() + _lockSetOffsets(t), _lockSets.data() + _lockSetOffsets(t + 1), other);
+    }
+    int numWorkers() const { return _numWorkers; }
+
+    // calls task(cell) once for every cell, returns when all tasks are done
+    // the task runs on a host thread, data written by device kernels has to be fenced before
+    template<class Task>
+    void run(const Task& task) const
+    {
+        auto tasks(_tasks);
+        auto lockSetOffsets(_lockSetOffsets);
+        auto lockSets(_lockSets);
+        auto owners(_owners);
+        auto counters(_counters);
+        const int numTasks = _tasks.extent(0);
+        counters(0) = 0;
+        counters(1) = 0;
+        counters(2) = 0;
+
+        Kokkos::parallel_for("CellTaskScheduler", WorkerPolicy(0, _numWorkers), [=](const int) {
+            auto release = [&](int t, int end) {
+                Kokkos::memory_fence();
+                for (int k = lockSetOffsets(t); k < end; k++)
+                    Kokkos::atomic_store(&owners(lockSets(k)), 0);
+            };
+            auto tryAcquire = [&](int t) {
+                for (int k = lockSetOffsets(t); k < lockSetOffsets(t + 1); k++)
+                {
+                    if(Kokkos::atomic_compare_exchange(&owners(lockSets(k)), 0, 1) != 0)
+                    {
+                        release(t, k);
+                        return false;
+                    }
+                }
+                Kokkos::memory_fence();
+                return true;
+            };
+            auto acquire = [&](int t) {
+                for (int k = lockSetOffsets(t); k < lockSetOffsets(t + 1); k++)
+                    while (Kokkos::atomic_compare_exchange(&owners(lockSets(k)), 0, 1) != 0) {}
+                Kokkos::memory_fence();
+                Kokkos::atomic_increment(&counters(2));
+            };
+            auto execute = [&](int t) {
+                task(tasks(t));
+                release(t, lockSetOffsets(t + 1));
+            };
+
+            int deferred[maxDeferred];
+            int numDeferred = 0;
+            while (true)
+            {
+                for (int d = 0; d < numDeferred;)
+                {
+                    if(tryAcquire(deferred[d]))
+                    {
+                        execute(deferred[d]);
+                        deferred[d] = deferred[--numDeferred];
+                    }
+                    else
+                        d++;
+                }
+                const int t = Kokkos::atomic_fetch_add(&counters(0), 1);
+                if(t >= numTasks)
+                    break;
+                if(tryAcquire(t))
+                {
+                    execute(t);
+                    continue;
+                }
+                Kokkos::atomic_increment(&counters(1));
+                if(numDeferred == maxDeferred)
+                {
+                    acquire(deferred[0]);
+                    execute(deferred[0]);
+                    deferred[0] = deferred[--numDeferred];
+                }
+                deferred[numDeferred++] = t;
+            }
+            for (int d = 0; d < numDeferred; d++)
+            {
+                acquire(deferred[d]);
+                execute(deferred[d]);
+            }
+        });
+        ExecutionSpace().fence();
+    }
+
+    // contention of the last run
+    CellTaskStatistics statistics() const
+    {
+        CellTaskStatistics stats;
+        stats.deferred = _counters(1);
+        stats.blocked = _counters(2);
+        return stats;
+    }
+
+private:
+    // visits interior cells colour by colour, cells of one colour are stride apart
+    template<class Visitor>
+    static void forEachInteriorCell(int numCellsPerDim, int haloWidth, const int stride[3], const Visitor& visit)
+    {
+        for (int colour = 0; colour < stride[0] * stride[1] * stride[2]; colour++)
+        {
+            const int start[3] = {colour % stride[0], (colour / stride[0]) % stride[1], colour / (stride[0] * stride[1])};
+            for (int z = start[2]; z < numCellsPerDim; z += stride[2])
+            {
+                for (int y = start[1]; y < numCellsPerDim; y += stride[1])
+                {
+                    for (int x = start[0]; x < numCellsPerDim; x += stride[0])
+                    {
+                        const int c[3] = {haloWidth + x, haloWidth + y, haloWidth + z};
+                        visit(c);
+                    }
+                }
+            }
+        }
+    }
+
+    int _numWorkers;
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::HostSpace> _tasks;
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::HostSpace> _lockSetOffsets;
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::HostSpace> _lockSets;
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::HostSpace> _owners;
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::HostSpace> _taskOfCell;
+    // next ticket, deferred tasks, blocked tasks
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::HostSpace> _counters;
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+enum class CompactionStrategy
+{
+    onesweep, twosweep, pullback, onesweep_noOrder,
+    onesweep_specialised, twosweep_specialised, pullback_specialised, onesweep_noOrder_specialised
+};
+
+struct CompactionDecision
+{
+    CompactionStrategy strategy = CompactionStrategy::onesweep;
+    // "calibrated" for the first call of a context, "explored" when a kernel other than the best one was retimed, "best" otherwise
+    std::string reason = "best";
+    double holeFraction = 0;
+    int cellSize = 0;
+    bool keepOrder = true;
+    // microseconds of the kernel on the container, and of timing all candidates on copies before it
+    double time = 0;
+    double calibrationTime = 0;
+
+    std::string to_string() const;
+};
+
+// picks a compaction kernel per call from cheap statistics: the hole fraction, the cell capacity and whether order has to be kept
+// calls fall into contexts by bins of these, every context starts with a calibration that times each candidate once,
+// afterwards the candidate with the lowest moving average time per slot runs and its time updates the average,
+// every explorationInterval-th call of a context instead retimes the candidate measured longest ago, so averages follow drifting costs
+class CompactionSelector
+{
+public:
+    CompactionSelector(double smoothing = 0.25, int explorationInterval = 16) : _smoothing(smoothing), _explorationInterval(explorationInterval) {}
+
+    static std::string name(CompactionStrategy strategy)
+    {
+        const char* names[] = {"onesweep", "twosweep", "pullback", "onesweep_noOrder",
+            "onesweep_specialised", "twosweep_specialised", "pullback_specialised", "onesweep_noOrder_specialised"};
+        return names[static_cast<int>(strategy)];
+    }
+
+    static bool keepsOrder(CompactionStrategy strategy)
+    {
+        return strategy != CompactionStrategy::onesweep_noOrder && strategy != CompactionStrategy::onesweep_noOrder_specialised;
+    }
+
+    static std::vector<CompactionStrategy> all()
+    {
+        return {CompactionStrategy::onesweep, CompactionStrategy::twosweep, CompactionStrategy::pullback, CompactionStrategy::onesweep_noOrder,
+            CompactionStrategy::onesweep_specialised, CompactionStrategy::twosweep_specialised, CompactionStrategy::pullback_specialised, CompactionStrategy::onesweep_noOrder_specialised};
+    }
+
+    // onesweep_noOrder only when order may change, specialised kernels only up to their largest compile-time capacity
+    static std::vector<CompactionStrategy> candidates(int cellSize, bool keepOrder)
+    {
+        std::vector<CompactionStrategy> result = {CompactionStrategy::onesweep, CompactionStrategy::twosweep, CompactionStrategy::pullback};
+        if(!keepOrder) result.push_back(CompactionStrategy::onesweep_noOrder);
+        if(cellSize <= 64)
+        {
+            result.push_back(CompactionStrategy::onesweep_specialised);
+            result.push_back(CompactionStrategy::twosweep_specialised);
+            result.push_back(CompactionStrategy::pullback_specialised);
+            if(!keepOrder) result.push_back(CompactionStrategy::onesweep_noOrder_specialised);
+        }
+        return result;
+    }
+
+    // hole fractions below 0.1, 0.3, 0.6 and above, capacities up to 8, 16, 32, 64 and beyond
+    int context(double holeFraction, int cellSize, bool keepOrder) const
+    {
+        const int holeBin = holeFraction < 0.1 ? 0 : (holeFraction < 0.3 ? 1 : (holeFraction < 0.6 ? 2 : 3));
+        const int capacityBin = cellSize <= 8 ? 0 : (cellSize <= 16 ? 1 : (cellSize <= 32 ? 2 : (cellSize <= 64 ? 3 : 4)));
+        return (holeBin * 5 + capacityBin) * 2 + keepOrder;
+    }
+
+    bool isCalibrated(int context) const { return _contexts.count(context) > 0; }
+
+    CompactionStrategy choose(int context, const std::vector<CompactionStrategy>& candidates, bool& explored)
+    {
+        ContextStatistics& stats = _contexts[context];
+        stats.calls++;
+        explored = _explorationInterval > 0 && stats.calls % _explorationInterval == 0;
+        CompactionStrategy chosen = candidates[0];
+        for (CompactionStrategy strategy : candidates)
+        {
+            const int s = static_cast<int>(strategy), c = static_cast<int>(chosen);
+            if(explored ? stats.lastMeasured[s] < stats.lastMeasured[c] : stats.average[s] < stats.average[c])
+                chosen = strategy;
+        }
+        return chosen;
+    }
+
+    // adds a measured time per slot to the moving average of strategy in context
+    void record(int context, CompactionStrategy strategy, double timePerSlot)
+    {
+        ContextStatistics& stats = _contexts[context];
+        const int s = static_cast<int>(strategy);
+        stats.average[s] = stats.measurements[s] == 0 ? timePerSlot : (1 - _smoothing) * stats.average[s] + _smoothing * timePerSlot;
+        stats.measurements[s]++;
+        stats.lastMeasured[s] = ++stats.clock;
+    }
+
+    // moving average time per slot in microseconds, negative if strategy was never timed in context
+    double average(int context, CompactionStrategy strategy) const
+    {
+        auto it = _contexts.find(context);
+        if(it == _contexts.end() || it->second.measurements[static_cast<int>(strategy)] == 0)
+            return -1;
+        return it->second.average[static_cast<int>(strategy)];
+    }
+
+private:
+    static constexpr int numStrategies = 8;
+
+    struct ContextStatistics
+    {
+        double average[numStrategies] = {};
+        long measurements[numStrategies] = {};
+        long lastMeasured[numStrategies] = {};
+        long calls = 0;
+        long clock = 0;
+    };
+
+    double _smoothing;
+    int _explorationInterval;
+    std::map<int, ContextStatistics> _contexts;
+};
+
+inline std::string CompactionDecision::to_string() const
+{
+    std::stringstream to_ret;
+    to_ret << CompactionSelector::name(strategy) << " (" << reason << "), holes " << holeFraction << ", capacity " << cellSize << ", "
+        << (keepOrder ? "order kept" : "order not kept") << ", " << time << " us";
+    if(calibrationTime > 0) to_ret << " after " << calibrationTime << " us calibration";
+    return to_ret.str();
+}
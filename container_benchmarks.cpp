@@ -0,0 +1,465 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <Kokkos_Core.hpp>
+
+#include <molecule_container.hpp>
+#include <index_converter.hpp>
+#include <cell_grid_tuner.hpp>
+#include <pair_traversal.hpp>
+#include <pair_traversal_simd.hpp>
+#include <partitioned_scheduler.hpp>
+#include <molecule_ensemble.hpp>
+#include <step_graph.hpp>
+
+// Strong and weak scaling of the MoleculeContainer operations over OpenMP thread counts.
+// Without --worker the executable re-launches itself once per thread count (Kokkos can only be initialised once per process),
+// collects the CSV rows of all runs and optionally compares them against a baseline file.
+//
+//   container_benchmarks --threads=1,2,4,8 --sizes=8,16 --study=both --ensemble=256 --output=results.csv --baseline=baseline.csv --tolerance=0.1
+//
+// Strong scaling keeps numCellsPerDim fixed, weak scaling grows it with the cube root of the thread count.
+// The ensemble study runs --ensemble small systems once as separate containers and once batched in a MoleculeEnsemble (0 skips it).
+
+struct BenchmarkOptions
+{
+    std::vector<int> threads;
+    std::vector<int> sizes = {8, 16};
+    std::string study = "both";
+    int moleculesPerCell = 4;
+    int repetitions = 5;
+    std::string output = "container_benchmarks.csv";
+    std::string baseline;
+    double tolerance = 0.1;
+    int ensembleSystems = 256;
+    bool worker = false;
+    std::string problems;
+};
+
+std::vector<int> parseIntList(const std::string& list)
+{
+    std::vector<int> values;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if(!item.empty()) values.push_back(std::stoi(item));
+    return values;
+}
+
+std::string valueOf(const std::string& arg, const std::string& key)
+{
+    return arg.rfind(key, 0) == 0 ? arg.substr(key.size()) : "";
+}
+
+BenchmarkOptions parseOptions(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(!valueOf(arg, "--threads=").empty()) options.threads = parseIntList(valueOf(arg, "--threads="));
+        else if(!valueOf(arg, "--sizes=").empty()) options.sizes = parseIntList(valueOf(arg, "--sizes="));
+        else if(!valueOf(arg, "--study=").empty()) options.study = valueOf(arg, "--study=");
+        else if(!valueOf(arg, "--molecules-per-cell=").empty()) options.moleculesPerCell = std::stoi(valueOf(arg, "--molecules-per-cell="));
+        else if(!valueOf(arg, "--repetitions=").empty()) options.repetitions = std::stoi(valueOf(arg, "--repetitions="));
+        else if(!valueOf(arg, "--output=").empty()) options.output = valueOf(arg, "--output=");
+        else if(!valueOf(arg, "--baseline=").empty()) options.baseline = valueOf(arg, "--baseline=");
+        else if(!valueOf(arg, "--tolerance=").empty()) options.tolerance = std::stod(valueOf(arg, "--tolerance="));
+        else if(!valueOf(arg, "--problems=").empty()) options.problems = valueOf(arg, "--problems=");
+        else if(!valueOf(arg, "--ensemble=").empty()) options.ensembleSystems = std::stoi(valueOf(arg, "--ensemble="));
+        else if(arg == "--worker") options.worker = true;
+    }
+    if(options.threads.empty())
+    {
+        int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (int t = 1; t < maxThreads; t *= 2)
+            options.threads.push_back(t);
+        options.threads.push_back(maxThreads);
+    }
+    return options;
+}
+
+int countNumaNodes()
+{
+    int nodes = 0;
+    DIR* dir = opendir("/sys/devices/system/node");
+    if(dir == nullptr)
+        return 0;
+    while (dirent* entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if(name.rfind("node", 0) == 0 && name.size() > 4 && std::isdigit(static_cast<unsigned char>(name[4])))
+            nodes++;
+    }
+    closedir(dir);
+    return nodes;
+}
+
+std::string environmentOr(const char* name, const std::string& fallback)
+{
+    const char* value = std::getenv(name);
+    return value ? value : fallback;
+}
+
+// ------------------------------------------------------------------ worker
+
+struct Sample
+{
+    std::string study;
+    std::string operation;
+    int numCellsPerDim;
+    long numMolecules;
+    std::vector<double> times;
+};
+
+double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+double timed(const std::function<void()>& operation)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+    operation();
+    Kokkos::fence();
+    auto t2 = std::chrono::high_resolution_clock::now();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count());
+}
+
+void printSamples(const std::map<std::string, Sample>& samples, int threads)
+{
+    for (const auto& entry : samples)
+    {
+        const Sample& sample = entry.second;
+        std::cout << sample.study << "," << sample.operation << "," << threads << "," << sample.numCellsPerDim << "," << sample.numMolecules << ","
+            << median(sample.times) << "," << *std::min_element(sample.times.begin(), sample.times.end()) << std::endl;
+    }
+}
+
+// moves every molecule by less than a cell width, as one time step would, keeping it inside the domain
+void displace(MoleculeContainer& container, const IndexConverter& indexConverter, int seed)
+{
+    for (int i = 0; i < container.getNumCells(); i++)
+        for (int j = 0; j < container.linkedCellNumMolecules(i); j++)
+            for (int d = 0; d < 3; d++)
+                container.moleculeData(i, j).pos[d] = std::min(std::max(container.moleculeData(i, j).pos[d] + 0.9 * indexConverter.cellWidth() * std::sin(container.moleculeData(i, j).id + 3.0 * d + seed), 0.0),
+                    indexConverter.domainSize - 1e-9);
+}
+
+void runProblem(const std::string& study, int numCellsPerDim, const BenchmarkOptions& options, int threads)
+{
+    // one cell width per unit of cutoff, positions are whole numbers in [0, domainSize)
+    const int domainSize = 2 * numCellsPerDim;
+    const double cutoff = 2;
+    const IndexConverter indexConverter(domainSize, numCellsPerDim);
+    std::map<std::string, Sample> samples;
+    const PartitionedScheduler scheduler;
+    auto record = [&](const std::string& operation, double time) {
+        Sample& sample = samples[operation];
+        sample.study = study;
+        sample.operation = operation;
+        sample.numCellsPerDim = numCellsPerDim;
+        sample.numMolecules = static_cast<long>(numCellsPerDim) * numCellsPerDim * numCellsPerDim * options.moleculesPerCell;
+        sample.times.push_back(time);
+    };
+
+    CompactionSelector compactionSelector;
+    for (int repetition = 0; repetition < options.repetitions; repetition++)
+    {
+        std::mt19937 gen(1984 + repetition);
+        std::uniform_int_distribution<> dis(0, RAND_MAX);
+        MoleculeContainer container(numCellsPerDim, options.moleculesPerCell, gen, dis);
+        record("populateRandomly", timed([&]() { container.populateRandomly(domainSize); }));
+
+        // capacity from the projected sort peak so that no repetition overflows
+        OccupancyStatistics stats = CellGridTuner::projectOccupancy(container, indexConverter);
+        const int cellSize = std::max(3 * options.moleculesPerCell, stats.peakOccupancy);
+        record("grow", timed([&]() { container.grow(cellSize); }));
+        // the random population lies anywhere in the domain, binning it once is set-up, the timed sort is that of one step
+        container.bin(indexConverter);
+        displace(container, indexConverter, 0);
+        container.reserve(CellGridTuner::projectOccupancy(container, indexConverter).peakOccupancy);
+        record("sort", timed([&]() { container.sort(indexConverter); }));
+
+        container.makeRandomHoles();
+        record("compact", timed([&]() { container.compact(); }));
+        // the selector learns across repetitions, its first call per context includes the calibration
+        container.makeRandomHoles();
+        record("compact_adaptive", timed([&]() { container.compact(compactionSelector, false); }));
+
+        LennardJonesKernel kernel(1.0, 1.0);
+        PairTraversal<LennardJonesKernel> traversal(container, kernel, cutoff);
+        container.clearForces();
+        record("traversal", timed([&]() { traversal.traverse(); }));
+        SimdPairTraversal<LennardJonesKernel> simdTraversal(container, kernel, cutoff);
+        container.clearForces();
+        record("traversal_simd", timed([&]() { simdTraversal.traverse(); }));
+
+        // force phase and output packing one after another on the default instance, then overlapped on two partitions
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> offsets("packOffsets", container.getNumCells() + 1);
+        Kokkos::View<double*[4], Kokkos::LayoutRight, Kokkos::SharedSpace> packed("packedPositions", static_cast<size_t>(container.getNumCells()) * container.getCellSize());
+        record("pack", timed([&]() { container.packPositions(offsets, packed); }));
+        record("step_sequential", timed([&]() {
+            container.clearForces();
+            traversal.traverse();
+            container.packPositions(offsets, packed);
+        }));
+        record("step_overlapped", timed([&]() {
+            scheduler.overlap([&](const MoleculeContainer::ExecutionSpace& space) {
+                container.clearForces(space);
+                traversal.traverse(space);
+            }, [&](const MoleculeContainer::ExecutionSpace& space) {
+                container.packPositions(offsets, packed, space);
+            });
+        }));
+
+        // a whole step (sort, clear, forces, pack) as separate launches and as one submission of a captured graph followed by packing
+        record("step_launched", timed([&]() {
+            container.sort(indexConverter);
+            container.clearForces();
+            traversal.traverseGlobal();
+            container.packPositions(offsets, packed);
+        }));
+        StepGraph<LennardJonesKernel> step(container, indexConverter, traversal, offsets, packed);
+        record("step_graph", timed([&]() { step.submit(); }));
+
+        // 16-bit cell-relative positions, the traversal reads 6 instead of 24 bytes of position per molecule
+        container.enableQuantisedPositions(indexConverter, 16);
+        container.clearForces();
+        record("traversal_quantised16", timed([&]() { traversal.traverse(); }));
+        container.disableQuantisedPositions();
+
+        // every molecule moves by less than a cell, sorted colour by colour and through the per-cell task scheduler
+        // cells need room for incoming molecules before their own leave
+        const CellTaskScheduler sortScheduler = CellTaskScheduler::forSort(numCellsPerDim, container.getHaloWidth());
+        displace(container, indexConverter, 1);
+        container.reserve(CellGridTuner::projectOccupancy(container, indexConverter).peakOccupancy);
+        record("sort_displaced", timed([&]() { container.sort(indexConverter); }));
+        displace(container, indexConverter, 2);
+        container.reserve(CellGridTuner::projectOccupancy(container, indexConverter).peakOccupancy);
+        record("sort_displaced_scheduled", timed([&]() { container.sort(indexConverter, sortScheduler); }));
+    }
+
+    printSamples(samples, threads);
+}
+
+// numSystems systems of 4^3 cells, each operation once over separate containers one after another and once over one batched ensemble
+void runEnsemble(int numSystems, const BenchmarkOptions& options, int threads)
+{
+    const int numCellsPerDim = 4;
+    const int domainSize = 2 * numCellsPerDim;
+    const IndexConverter indexConverter(domainSize, numCellsPerDim);
+    std::map<std::string, Sample> samples;
+    auto record = [&](const std::string& operation, double time) {
+        Sample& sample = samples[operation];
+        sample.study = "ensemble";
+        sample.operation = operation;
+        sample.numCellsPerDim = numCellsPerDim;
+        sample.numMolecules = static_cast<long>(numSystems) * numCellsPerDim * numCellsPerDim * numCellsPerDim * options.moleculesPerCell;
+        sample.times.push_back(time);
+    };
+
+    for (int repetition = 0; repetition < options.repetitions; repetition++)
+    {
+        std::mt19937 gen(1984 + repetition);
+        std::uniform_int_distribution<> dis(0, RAND_MAX);
+        std::vector<MoleculeContainer> containers;
+        containers.reserve(numSystems);
+        record("separate_setup", timed([&]() {
+            for (int s = 0; s < numSystems; s++)
+                containers.emplace_back(numCellsPerDim, options.moleculesPerCell, gen, dis);
+        }));
+        record("separate_populate", timed([&]() {
+            for (MoleculeContainer& container : containers)
+                container.populateRandomly(domainSize);
+        }));
+        // populateRandomly scatters molecules over the whole domain, sort only handles moves of one cell, as the ensemble's population has
+        for (MoleculeContainer& container : containers)
+        {
+            container.bin(indexConverter);
+            displace(container, indexConverter, repetition);
+            container.reserve(std::max(3 * options.moleculesPerCell, CellGridTuner::projectOccupancy(container, indexConverter).peakOccupancy));
+        }
+        record("separate_sort", timed([&]() {
+            for (MoleculeContainer& container : containers)
+                container.sort(indexConverter);
+        }));
+        for (MoleculeContainer& container : containers)
+            container.makeRandomHoles();
+        record("separate_compact", timed([&]() {
+            for (MoleculeContainer& container : containers)
+                container.compact();
+        }));
+        containers.clear();
+
+        std::unique_ptr<MoleculeEnsemble> ensemble;
+        record("batched_setup", timed([&]() { ensemble.reset(new MoleculeEnsemble(numSystems, numCellsPerDim, options.moleculesPerCell, domainSize, 1984 + repetition)); }));
+        record("batched_populate", timed([&]() { ensemble->populateRandomly(options.moleculesPerCell); }));
+        ensemble->reserve(std::max(3 * options.moleculesPerCell, ensemble->projectPeakOccupancy()));
+        record("batched_sort", timed([&]() { ensemble->sort(); }));
+        ensemble->makeRandomHoles(0.25);
+        record("batched_compact", timed([&]() { ensemble->compact(); }));
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> counts("ensembleCounts", numSystems);
+        record("batched_count", timed([&]() { ensemble->countMolecules(counts); }));
+    }
+
+    printSamples(samples, threads);
+}
+
+int runWorker(int argc, char* argv[], const BenchmarkOptions& options)
+{
+    Kokkos::ScopeGuard guard(argc, argv);
+    const int threads = Kokkos::DefaultExecutionSpace().concurrency();
+    std::stringstream problems(options.problems);
+    std::string problem;
+    while (std::getline(problems, problem, ','))
+    {
+        const size_t colon = problem.find(':');
+        if(problem.substr(0, colon) == "ensemble")
+            runEnsemble(std::stoi(problem.substr(colon + 1)), options, threads);
+        else
+            runProblem(problem.substr(0, colon), std::stoi(problem.substr(colon + 1)), options, threads);
+    }
+    return 0;
+}
+
+// ------------------------------------------------------------------ driver
+
+using ResultKey = std::string;
+
+ResultKey keyOf(const std::string& row)
+{
+    // study,operation,threads,numCellsPerDim identify a measurement
+    std::stringstream stream(row);
+    std::string field, key;
+    for (int i = 0; i < 4 && std::getline(stream, field, ','); i++)
+        key += field + ",";
+    return key;
+}
+
+double medianOf(const std::string& row)
+{
+    std::stringstream stream(row);
+    std::string field;
+    for (int i = 0; i < 6; i++)
+        std::getline(stream, field, ',');
+    return std::stod(field);
+}
+
+std::map<ResultKey, double> readResults(const std::string& fileName)
+{
+    std::map<ResultKey, double> results;
+    std::ifstream file(fileName);
+    std::string row;
+    while (std::getline(file, row))
+    {
+        if(row.empty() || row[0] == '#' || row.rfind("study,", 0) == 0)
+            continue;
+        results[keyOf(row)] = medianOf(row);
+    }
+    return results;
+}
+
+int runDriver(const char* executable, const BenchmarkOptions& options)
+{
+    // pin threads unless the caller already decided, the choice ends up in the output either way
+    setenv("OMP_PROC_BIND", environmentOr("OMP_PROC_BIND", "spread").c_str(), 1);
+    setenv("OMP_PLACES", environmentOr("OMP_PLACES", "threads").c_str(), 1);
+
+    std::vector<std::string> rows;
+    for (int threads : options.threads)
+    {
+        std::string problems;
+        for (int size : options.sizes)
+        {
+            if(options.study == "strong" || options.study == "both")
+                problems += "strong:" + std::to_string(size) + ",";
+            if(options.study == "weak" || options.study == "both")
+                problems += "weak:" + std::to_string(static_cast<int>(std::lround(size * std::cbrt(threads)))) + ",";
+        }
+        if(options.ensembleSystems > 0)
+            problems += "ensemble:" + std::to_string(options.ensembleSystems) + ",";
+        std::stringstream command;
+        command << executable << " --worker --kokkos-num-threads=" << threads << " --problems=" << problems
+            << " --molecules-per-cell=" << options.moleculesPerCell << " --repetitions=" << options.repetitions;
+        std::cout << "Running " << threads << " thread(s)" << std::endl;
+        FILE* pipe = popen(command.str().c_str(), "r");
+        if(pipe == nullptr)
+        {
+            std::cout << "Could not launch " << command.str() << std::endl;
+            return 1;
+        }
+        char buffer[1024];
+        while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+        {
+            std::string row(buffer);
+            row.erase(row.find_last_not_of("\r\n") + 1);
+            // Kokkos may print warnings, only result rows have seven fields
+            if(std::count(row.begin(), row.end(), ',') == 6)
+                rows.push_back(row);
+        }
+        if(pclose(pipe) != 0)
+        {
+            std::cout << "Worker for " << threads << " thread(s) failed" << std::endl;
+            return 1;
+        }
+    }
+
+    char hostname[256] = "unknown";
+    gethostname(hostname, sizeof(hostname));
+    std::ofstream output(options.output);
+    output << "# host=" << hostname << std::endl;
+    output << "# OMP_PROC_BIND=" << environmentOr("OMP_PROC_BIND", "") << std::endl;
+    output << "# OMP_PLACES=" << environmentOr("OMP_PLACES", "") << std::endl;
+    output << "# numa_nodes=" << countNumaNodes() << std::endl;
+    output << "# hardware_threads=" << std::thread::hardware_concurrency() << std::endl;
+    output << "study,operation,threads,numCellsPerDim,numMolecules,median_us,min_us" << std::endl;
+    for (const std::string& row : rows)
+        output << row << std::endl;
+    output.close();
+    std::cout << rows.size() << " results written to " << options.output << std::endl;
+
+    if(options.baseline.empty())
+        return 0;
+    std::map<ResultKey, double> baseline = readResults(options.baseline);
+    int regressions = 0;
+    for (const std::string& row : rows)
+    {
+        auto it = baseline.find(keyOf(row));
+        if(it == baseline.end() || it->second <= 0)
+            continue;
+        const double ratio = medianOf(row) / it->second;
+        if(ratio > 1 + options.tolerance)
+        {
+            std::cout << "REGRESSION " << keyOf(row) << " " << it->second << " us -> " << medianOf(row) << " us (x" << ratio << ")" << std::endl;
+            regressions++;
+        }
+    }
+    std::cout << regressions << " regression(s) against " << options.baseline << " with tolerance " << options.tolerance << std::endl;
+    return regressions > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options = parseOptions(argc, argv);
+    if(options.worker)
+        return runWorker(argc, argv, options);
+    return runDriver(argv[0], options);
+}
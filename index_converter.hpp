@@ -2,31 +2,47 @@
 
 #include <iostream>
 
+#include <Kokkos_Core.hpp>
+
+// maps positions to linked cell indices
+// with haloWidth > 0 the domain is periodic and the grid carries haloWidth layers of ghost cells on every side,
+// indices then refer to the grid including the halo, interior cell (0,0,0) has index haloWidth*(1 + n + n*n) with n = numCellsPerDim + 2*haloWidth
 class IndexConverter
 {
 public:
-    IndexConverter(int domainSize, int numCellsPerDim) : domainSize(domainSize), numCellsPerDim(numCellsPerDim) {}
-    IndexConverter() : domainSize(0), numCellsPerDim(0) {}
-    void reset(int domainSize, int numCellsPerDim)
+    KOKKOS_FUNCTION IndexConverter(int domainSize, int numCellsPerDim, int haloWidth = 0) : domainSize(domainSize), numCellsPerDim(numCellsPerDim), haloWidth(haloWidth) {}
+    KOKKOS_FUNCTION IndexConverter() : domainSize(0), numCellsPerDim(0), haloWidth(0) {}
+    void reset(int domainSize, int numCellsPerDim, int haloWidth = 0)
     {
         this->domainSize = domainSize;
         this->numCellsPerDim = numCellsPerDim;
+        this->haloWidth = haloWidth;
+    }
+    KOKKOS_FUNCTION double cellWidth() const
+    {
+        return static_cast<double>(domainSize) / numCellsPerDim;
+    }
+    KOKKOS_FUNCTION int numCellsPerDimWithHalo() const
+    {
+        return numCellsPerDim + 2 * haloWidth;
+    }
+    KOKKOS_FUNCTION bool isPeriodic() const
+    {
+        return haloWidth > 0;
+    }
+    // cell coordinate along one dimension including the halo offset, positions beyond the grid are clamped to its outermost cells
+    KOKKOS_FUNCTION int getCoordinate(double pos) const
+    {
+        const double scaled = Kokkos::floor(pos / cellWidth());
+        const int last = numCellsPerDimWithHalo() - 1;
+        if(scaled < -haloWidth) return 0;
+        if(scaled > last - haloWidth) return last;
+        return static_cast<int>(scaled) + haloWidth;
     }
     KOKKOS_FUNCTION int getIndex(double posx, double posy, double posz) const
     {
-        int xid = -1, yid = -1, zid = -1;
-        posx -= (domainSize/numCellsPerDim);
-        posy -= (domainSize/numCellsPerDim);
-        posz -= (domainSize/numCellsPerDim);
-        int i = 0;
-        while(xid == -1 || yid == -1 || zid == -1)
-        {
-            if(xid == -1 && posx < 0) xid = i; else posx -= (domainSize/numCellsPerDim);
-            if(yid == -1 && posy < 0) yid = i; else posy -= (domainSize/numCellsPerDim);
-            if(zid == -1 && posz < 0) zid = i; else posz -= (domainSize/numCellsPerDim);
-            i++;
-        }
-        return xid + yid*numCellsPerDim + zid*numCellsPerDim*numCellsPerDim;
+        const int n = numCellsPerDimWithHalo();
+        return getCoordinate(posx) + getCoordinate(posy)*n + getCoordinate(posz)*n*n;
     }
     KOKKOS_FUNCTION int getIndex(double pos[3]) const
     {
@@ -40,5 +56,15 @@ public:
     {
         return isInIndex(pos[0], pos[1], pos[2], index);
     }
-    int domainSize, numCellsPerDim;
-};
\ No newline at end of file
+    // maps a position back into [0, domainSize) along every dimension
+    KOKKOS_FUNCTION void wrap(double pos[3]) const
+    {
+        for (int d = 0; d < 3; d++)
+        {
+            pos[d] -= Kokkos::floor(pos[d] / domainSize) * domainSize;
+            // rounding of tiny negative positions can land exactly on the upper bound
+            if(pos[d] >= domainSize) pos[d] = 0;
+        }
+    }
+    int domainSize, numCellsPerDim, haloWidth;
+};
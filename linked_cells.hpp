@@ -8,14 +8,17 @@
 #include <Kokkos_Core.hpp>
 
 #include <molecule.hpp>
+#include <molecule_location_index.hpp>
+#include <quantised_positions.hpp>
 
 class LinkedCell
 {
 public:
-    KOKKOS_FUNCTION LinkedCell() : linkedCellNumMolecules(NULL), moleculeData(NULL), linkedCellIndex(0) {}
+    KOKKOS_FUNCTION LinkedCell() : linkedCellNumMolecules(NULL), moleculeData(NULL), linkedCellIndex(0), moleculeLocations(NULL), quantisedPositions(NULL) {}
 
-    KOKKOS_FUNCTION LinkedCell(const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>* nMolecules, const Kokkos::View<Molecule**, Kokkos::LayoutRight, Kokkos::SharedSpace>* moleculeSlice, unsigned int cellIndex) 
-        : linkedCellNumMolecules(nMolecules), moleculeData(moleculeSlice), linkedCellIndex(cellIndex) {}
+    KOKKOS_FUNCTION LinkedCell(const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>* nMolecules, const Kokkos::View<Molecule**, Kokkos::LayoutRight, Kokkos::SharedSpace>* moleculeSlice, unsigned int cellIndex,
+        const MoleculeLocationIndex* locations = NULL, const QuantisedPositions* quantised = NULL) 
+        : linkedCellNumMolecules(nMolecules), moleculeData(moleculeSlice), linkedCellIndex(cellIndex), moleculeLocations(locations), quantisedPositions(quantised) {}
     
     class Iterator
     {
@@ -57,13 +60,19 @@ private:
 
     KOKKOS_FUNCTION void insert(Molecule& molecule)
     {
+        if(moleculeLocations) moleculeLocations->set(molecule.id, linkedCellIndex, numMolecules());
         (*moleculeData)(linkedCellIndex, numMolecules()) = molecule;
+        // the codes are the position while quantisation is on, molecule.pos is taken as the position to store
+        if(quantisedPositions && quantisedPositions->enabled()) quantisedPositions->encode(linkedCellIndex, numMolecules(), molecule.pos);
         changeMoleculeCount(+1);
     }
     KOKKOS_FUNCTION void remove(int moleculeIdx)
     {
+        if(moleculeLocations) moleculeLocations->clear((*moleculeData)(linkedCellIndex, moleculeIdx).id);
         (*moleculeData)(linkedCellIndex, moleculeIdx) = (*moleculeData)(linkedCellIndex, numMolecules() - 1);
+        if(quantisedPositions && quantisedPositions->enabled()) quantisedPositions->copy(linkedCellIndex, numMolecules() - 1, linkedCellIndex, moleculeIdx);
         changeMoleculeCount(-1);
+        if(moleculeLocations && moleculeIdx < static_cast<int>(numMolecules())) moleculeLocations->set((*moleculeData)(linkedCellIndex, moleculeIdx).id, linkedCellIndex, moleculeIdx);
     }
     KOKKOS_FUNCTION void clear()
     {
@@ -80,4 +89,6 @@ private:
     const Kokkos::View<Molecule**, Kokkos::LayoutRight, Kokkos::SharedSpace>* moleculeData;
     const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>* linkedCellNumMolecules;
     const unsigned int linkedCellIndex;
+    const MoleculeLocationIndex* moleculeLocations;
+    const QuantisedPositions* quantisedPositions;
 };
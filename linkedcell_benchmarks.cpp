@@ -1,5 +1,7 @@
 #include <iostream>
 #include <random>
+#include <map>
+#include <string>
 
 #include <Kokkos_Core.hpp>
 
@@ -16,6 +18,14 @@ int main(int argc, char* argv[])
 
     int num_benchmarks = 1000;
     long onesweepTimer, twosweepTimer, pullbackTimer, onesweep_noOrderTimer = 0;
+    long onesweepSpecTimer = 0, twosweepSpecTimer = 0, pullbackSpecTimer = 0, onesweep_noOrderSpecTimer = 0;
+    // adaptive totals with order not kept and kept, the containers alternate between the two
+    long adaptiveTimer[2] = {0, 0};
+    double adaptiveCalibrationTimer[2] = {0, 0};
+    std::map<std::string, int> adaptiveChoices;
+    // shared by all containers so that it keeps learning over the whole run
+    CompactionSelector selector;
+    AllocationStatistics scratchAllocations;
     for(int i = 0; i < num_benchmarks; i++)
     {
         int numcells = dis(gen) % 50000 + 2;
@@ -34,11 +44,34 @@ int main(int argc, char* argv[])
         //std::cout << "pullback after: " << pullbackTimer << std::endl;
         onesweep_noOrderTimer += container.compactor_onesweep_noOrder();
         //std::cout << "oneSweep_noOrder after: " << onesweep_noOrderTimer << std::endl;
+        onesweepSpecTimer += container.compactor_onesweep_specialised();
+        twosweepSpecTimer += container.compactor_twosweep_specialised();
+        pullbackSpecTimer += container.compactor_pullback_specialised();
+        onesweep_noOrderSpecTimer += container.compactor_onesweep_noOrder_specialised();
+        // last, it compacts the container itself
+        const bool keepOrder = i % 2 == 1;
+        CompactionDecision decision = container.compact(selector, keepOrder);
+        adaptiveTimer[keepOrder] += static_cast<long>(decision.time);
+        adaptiveCalibrationTimer[keepOrder] += decision.calibrationTime;
+        adaptiveChoices[CompactionSelector::name(decision.strategy) + (keepOrder ? " (order kept)" : " (order not kept)")]++;
+        scratchAllocations.allocations += container.scratchAllocationStatistics().allocations;
+        scratchAllocations.reuses += container.scratchAllocationStatistics().reuses;
+        scratchAllocations.bytesAllocated += container.scratchAllocationStatistics().bytesAllocated;
+        scratchAllocations.bytesPooled += container.scratchAllocationStatistics().bytesPooled;
         //std::cout << "----------------------------------------------" << std::endl;
     }
     std::cout << "oneSweep: " << onesweepTimer << std::endl;
     std::cout << "twoSweep: " << twosweepTimer << std::endl;
     std::cout << "pullback: " << pullbackTimer << std::endl;
     std::cout << "oneSweep_noOrder: " << onesweep_noOrderTimer << std::endl;
+    std::cout << "oneSweep (specialised): " << onesweepSpecTimer << std::endl;
+    std::cout << "twoSweep (specialised): " << twosweepSpecTimer << std::endl;
+    std::cout << "pullback (specialised): " << pullbackSpecTimer << std::endl;
+    std::cout << "oneSweep_noOrder (specialised): " << onesweep_noOrderSpecTimer << std::endl;
+    std::cout << "adaptive, order not kept: " << adaptiveTimer[0] << " (+" << static_cast<long>(adaptiveCalibrationTimer[0]) << " calibration)" << std::endl;
+    std::cout << "adaptive, order kept: " << adaptiveTimer[1] << " (+" << static_cast<long>(adaptiveCalibrationTimer[1]) << " calibration)" << std::endl;
+    for (const auto& choice : adaptiveChoices)
+        std::cout << "  " << choice.first << " chosen " << choice.second << " times" << std::endl;
+    std::cout << "Scratch " << scratchAllocations.to_string() << std::endl;
     return 0;
 }
\ No newline at end of file
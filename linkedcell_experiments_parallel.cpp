@@ -19,9 +19,31 @@ int main(int argc, char* argv[])
     container.printData();
     container.makeRandomHoles();
     container.printData();
-    //container.compactor_onesweep();
-    //container.compactor_twosweep();
-    //container.compactor_pullback();
-    container.compactor_onesweep_noOrder();
+    // the container picks the compactor from its hole fraction and capacity, order of the remaining entries may change
+    container.compact(false, true);
+    container.printData();
+
+    // every specialised kernel has to leave the same rows as its generic counterpart, capacities below, at and above the largest specialisation
+    const CompactionStrategy pairs[][2] = {{CompactionStrategy::onesweep, CompactionStrategy::onesweep_specialised}, {CompactionStrategy::twosweep, CompactionStrategy::twosweep_specialised},
+        {CompactionStrategy::pullback, CompactionStrategy::pullback_specialised}, {CompactionStrategy::onesweep_noOrder, CompactionStrategy::onesweep_noOrder_specialised}};
+    long mismatches = 0;
+    long failures = 0;
+    for (int cellSize : {3, 8, 12, 31, 64, 70})
+    {
+        MoleculeContainer checked(200, cellSize, gen, dis);
+        checked.populateRandomly();
+        checked.makeRandomHoles();
+        for (const auto& pair : pairs)
+            mismatches += checked.countMismatches(pair[0], pair[1]);
+        failures += checked.verifyCompactors(true);
+        // both selector paths, each calibration checks its candidates against pullback in debug builds
+        checked.compact(true);
+        checked.makeRandomHoles();
+        checked.compact(false);
+    }
+    std::cout << "Specialised vs generic compactors, mismatching cells: " << mismatches << std::endl;
+    std::cout << "Compactors vs pullback (entries kept, holes at the tail, order where promised), failing cells: " << failures << std::endl;
+    if(mismatches > 0 || failures > 0)
+        return 1;
     return 0;
 }
\ No newline at end of file
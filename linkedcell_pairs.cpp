@@ -0,0 +1,505 @@
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <map>
+
+#include <Kokkos_Core.hpp>
+
+#include <molecule_container.hpp>
+#include <index_converter.hpp>
+#include <pair_traversal.hpp>
+#include <pair_traversal_simd.hpp>
+#include <step_graph.hpp>
+
+std::vector<double> collectForces(const MoleculeContainer& container)
+{
+    std::vector<double> forces;
+    for (int i = 0; i < container.getNumCells(); i++)
+    {
+        if(container.isHaloCell(i))
+            continue;
+        for (int j = 0; j < container.linkedCellNumMolecules(i); j++)
+            for (int d = 0; d < 3; d++)
+                forces.push_back(container.moleculeData(i, j).f[d]);
+    }
+    return forces;
+}
+
+// all-pairs reference with minimum-image distances, same molecule order as collectForces
+std::vector<double> minimumImageForces(const MoleculeContainer& container, const LennardJonesKernel& kernel, double cutoff, double domainSize)
+{
+    std::vector<const Molecule*> molecules;
+    for (int i = 0; i < container.getNumCells(); i++)
+    {
+        if(container.isHaloCell(i))
+            continue;
+        for (int j = 0; j < container.linkedCellNumMolecules(i); j++)
+            molecules.push_back(&container.moleculeData(i, j));
+    }
+    std::vector<double> forces(3 * molecules.size(), 0);
+    for (size_t i = 0; i < molecules.size(); i++)
+    {
+        for (size_t j = 0; j < molecules.size(); j++)
+        {
+            double dr[3];
+            for (int d = 0; d < 3; d++)
+            {
+                dr[d] = molecules[i]->pos[d] - molecules[j]->pos[d];
+                dr[d] -= std::round(dr[d] / domainSize) * domainSize;
+            }
+            const double r2 = dr[0] * dr[0] + dr[1] * dr[1] + dr[2] * dr[2];
+            if(r2 < cutoff * cutoff && r2 > 0)
+                for (int d = 0; d < 3; d++)
+                    forces[3 * i + d] += kernel.forceOverDistance(r2) * dr[d];
+        }
+    }
+    return forces;
+}
+
+double maxDeviation(const std::vector<double>& a, const std::vector<double>& b)
+{
+    double deviation = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        deviation = std::max(deviation, std::abs(a[i] - b[i]) / std::max(1.0, std::abs(a[i])));
+    return deviation;
+}
+
+// copies the interior molecules of source into the cells of target given by indexConverter, target capacity is grown to fit
+void rebin(const MoleculeContainer& source, MoleculeContainer& target, const IndexConverter& indexConverter)
+{
+    std::vector<int> occupancy(target.getNumCells(), 0);
+    for (int i = 0; i < source.getNumCells(); i++)
+        if(!source.isHaloCell(i))
+            for (int j = 0; j < source.linkedCellNumMolecules(i); j++)
+                occupancy[indexConverter.getIndex(source.moleculeData(i, j).pos)]++;
+    target.reserve(*std::max_element(occupancy.begin(), occupancy.end()));
+    Kokkos::deep_copy(target.linkedCellNumMolecules, 0);
+    for (int i = 0; i < source.getNumCells(); i++)
+    {
+        if(source.isHaloCell(i))
+            continue;
+        for (int j = 0; j < source.linkedCellNumMolecules(i); j++)
+        {
+            Molecule m = source.moleculeData(i, j);
+            target.insert(indexConverter.getIndex(m.pos), m);
+        }
+    }
+}
+
+// half-shell traversals on cells of cutoff/k against the all-pairs reference, returns the largest deviation
+double checkHalfShell(const MoleculeContainer& source, const LennardJonesKernel& kernel, double cutoff, int domainSize, bool periodic, int cellsPerCutoff)
+{
+    std::mt19937 gen(1984);
+    std::uniform_int_distribution<> dis(0, RAND_MAX);
+    const int numCellsPerDim = static_cast<int>(std::round(domainSize / cutoff)) * cellsPerCutoff;
+    IndexConverter indexConverter(domainSize, numCellsPerDim, periodic ? cellsPerCutoff : 0);
+    MoleculeContainer container(numCellsPerDim, 1, gen, dis, MoleculeContainerOptions().setPeriodic(periodic).setCellsPerCutoff(cellsPerCutoff));
+    rebin(source, container, indexConverter);
+    container.refreshHalo(indexConverter);
+
+    HalfShellTraversal<LennardJonesKernel> traversal(container, indexConverter, kernel, cutoff);
+    container.clearForces();
+    auto t1 = std::chrono::high_resolution_clock::now();
+    traversal.traverse();
+    auto t2 = std::chrono::high_resolution_clock::now();
+    // without periodic images the reference must not wrap, a domain far larger than any distance disables it
+    const double referenceDomain = periodic ? domainSize : 1e9;
+    const std::vector<double> colouredForces = collectForces(container);
+    const double deviation = maxDeviation(minimumImageForces(container, kernel, cutoff, referenceDomain), colouredForces);
+    // the same traversal without colour barriers has to give the same forces up to summation order
+    const CellTaskScheduler scheduler = CellTaskScheduler::forStencil(numCellsPerDim, container.getHaloWidth(), traversal.stencil());
+    container.clearForces();
+    traversal.traverse(scheduler);
+    const double scheduledDeviation = maxDeviation(colouredForces, collectForces(container));
+    // candidate volume in units of cutoff^3, the 27 full cells of the classic scheme cover 27
+    const double candidateVolume = traversal.stencil().size() * std::pow(1.0 / cellsPerCutoff, 3);
+    std::cout << (periodic ? "periodic " : "") << "half shell rc/" << cellsPerCutoff << ": " << traversal.stencil().size() << " stencil cells (" << candidateVolume << " rc^3 per half shell), "
+        << traversal.stencil().numColours() << " colours, " << std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count() << " us, max deviation vs reference: " << deviation << ", scheduled vs coloured: " << scheduledDeviation << " (" << scheduler.statistics().to_string() << ")" << std::endl;
+    return std::max(deviation, scheduledDeviation);
+}
+
+
+// displaces every molecule of a periodic box by less than a cell, sorts and traverses it once with double and once with quantised positions
+// returns false if a quantised position is further from its double counterpart than the three roundings (encode, setPosition, sort) allow
+bool checkQuantised(int bits, int domainSize, int numCellsPerDim, int cellSizeMolecules, const LennardJonesKernel& kernel, double cutoff)
+{
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<> dis(0, RAND_MAX);
+    IndexConverter indexConverter(domainSize, numCellsPerDim, 1);
+    MoleculeContainer reference(numCellsPerDim, cellSizeMolecules, gen, dis, MoleculeContainerOptions().setPeriodic());
+    MoleculeContainer quantised(numCellsPerDim, cellSizeMolecules, gen, dis, MoleculeContainerOptions().setPeriodic());
+    reference.populateRandomly(domainSize);
+    quantised.populateRandomly(domainSize);
+    // codes only reach one cell beyond their own, so molecules have to be in their cells before encoding
+    reference.bin(indexConverter);
+    quantised.bin(indexConverter);
+    // every molecule moves below, so cells need room for the incoming ones before their own leave
+    reference.reserve(8 * cellSizeMolecules);
+    quantised.reserve(8 * cellSizeMolecules);
+    quantised.enableQuantisedPositions(indexConverter, bits);
+
+    // the two containers were binned separately and may hold a molecule in different slots, so each shift follows the molecule's own id
+    const double cellWidth = indexConverter.cellWidth();
+    for (MoleculeContainer* container : {&reference, &quantised})
+    {
+        for (int i = 0; i < container->getNumCells(); i++)
+        {
+            if(container->isHaloCell(i))
+                continue;
+            for (int j = 0; j < container->linkedCellNumMolecules(i); j++)
+            {
+                double pos[3];
+                container->getPosition(i, j, pos);
+                for (int d = 0; d < 3; d++)
+                    pos[d] += 0.9 * cellWidth * std::sin(container->moleculeData(i, j).id + 2.0 * d);
+                container->setPosition(i, j, pos);
+            }
+        }
+    }
+    for (MoleculeContainer* container : {&reference, &quantised})
+    {
+        container->sort(indexConverter);
+        container->refreshHalo(indexConverter);
+        container->clearForces();
+        PairTraversal<LennardJonesKernel>(*container, kernel, cutoff).traverse();
+    }
+
+    // results are compared by id, populateRandomly numbers molecules by cell and slot, halo cells included
+    std::vector<double> referencePositions(3 * reference.getNumCells() * cellSizeMolecules);
+    std::vector<double> referenceForces(referencePositions.size());
+    for (int i = 0; i < reference.getNumCells(); i++)
+        if(!reference.isHaloCell(i))
+            for (int j = 0; j < reference.linkedCellNumMolecules(i); j++)
+                for (int d = 0; d < 3; d++)
+                {
+                    referencePositions[3 * reference.moleculeData(i, j).id + d] = reference.moleculeData(i, j).pos[d];
+                    referenceForces[3 * reference.moleculeData(i, j).id + d] = reference.moleculeData(i, j).f[d];
+                }
+    double positionError = 0, forceDeviation = 0;
+    for (int i = 0; i < quantised.getNumCells(); i++)
+    {
+        if(quantised.isHaloCell(i))
+            continue;
+        for (int j = 0; j < quantised.linkedCellNumMolecules(i); j++)
+        {
+            double pos[3];
+            quantised.getPosition(i, j, pos);
+            const int id = quantised.moleculeData(i, j).id;
+            for (int d = 0; d < 3; d++)
+            {
+                // molecules within rounding of the boundary may have wrapped on one side only
+                double difference = pos[d] - referencePositions[3 * id + d];
+                difference -= std::round(difference / domainSize) * domainSize;
+                positionError = std::max(positionError, std::abs(difference));
+                const double f = quantised.moleculeData(i, j).f[d];
+                forceDeviation = std::max(forceDeviation, std::abs(f - referenceForces[3 * id + d]) / std::max(1.0, std::abs(referenceForces[3 * id + d])));
+            }
+        }
+    }
+    const double bound = 1.5 * quantised.quantisedPositions.resolution();
+    std::cout << "quantised " << bits << " bit: " << quantised.quantisedPositions.bytesPerMolecule() << " instead of " << 3 * sizeof(double) << " bytes of position per molecule, max position error "
+        << positionError << " (bound " << bound << "), max force deviation " << forceDeviation << std::endl;
+
+    // removing and re-inserting through LinkedCell has to carry the codes along
+    double insertError = 0;
+    for (int i = 0; i < quantised.getNumCells(); i++)
+    {
+        if(quantised.isHaloCell(i) || quantised.linkedCellNumMolecules(i) < 2)
+            continue;
+        Molecule moved = quantised.moleculeData(i, 0);
+        double expected[3], stored[3];
+        quantised.getPosition(i, 0, expected);
+        for (int d = 0; d < 3; d++)
+            moved.pos[d] = expected[d];
+        quantised[i].remove(0);
+        quantised[i].insert(moved);
+        quantised.getPosition(i, quantised.linkedCellNumMolecules(i) - 1, stored);
+        for (int d = 0; d < 3; d++)
+            insertError = std::max(insertError, std::abs(stored[d] - expected[d]));
+        break;
+    }
+    return positionError <= bound && insertError <= quantised.quantisedPositions.resolution();
+}
+
+// the scheduled and the coloured sort of a displaced periodic box against a serial reference that bins every molecule by its wrapped position,
+// molecules move at most one cell, the reach of CellTaskScheduler::forSort, and no molecule may get lost or duplicated
+bool checkScheduledSort(int domainSize, int numCellsPerDim, int cellSizeMolecules)
+{
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<> dis(0, RAND_MAX);
+    IndexConverter indexConverter(domainSize, numCellsPerDim, 1);
+    MoleculeContainer coloured(numCellsPerDim, cellSizeMolecules, gen, dis, MoleculeContainerOptions().setPeriodic());
+    MoleculeContainer scheduled(numCellsPerDim, cellSizeMolecules, gen, dis, MoleculeContainerOptions().setPeriodic());
+    const CellTaskScheduler scheduler = CellTaskScheduler::forSort(numCellsPerDim, scheduled.getHaloWidth());
+    for (MoleculeContainer* container : {&coloured, &scheduled})
+    {
+        container->populateRandomly(domainSize);
+        container->reserve(8 * cellSizeMolecules);
+        container->bin(indexConverter);
+        for (int i = 0; i < container->getNumCells(); i++)
+            if(!container->isHaloCell(i))
+                for (int j = 0; j < container->linkedCellNumMolecules(i); j++)
+                    for (int d = 0; d < 3; d++)
+                        container->moleculeData(i, j).pos[d] += 0.9 * indexConverter.cellWidth() * std::sin(container->moleculeData(i, j).id + 5.0 * d);
+    }
+
+    std::vector<std::vector<int>> reference(scheduled.getNumCells());
+    int numMolecules = 0;
+    for (int i = 0; i < scheduled.getNumCells(); i++)
+    {
+        if(scheduled.isHaloCell(i))
+            continue;
+        for (int j = 0; j < scheduled.linkedCellNumMolecules(i); j++)
+        {
+            double pos[3] = {scheduled.moleculeData(i, j).pos[0], scheduled.moleculeData(i, j).pos[1], scheduled.moleculeData(i, j).pos[2]};
+            indexConverter.wrap(pos);
+            reference[indexConverter.getIndex(pos)].push_back(scheduled.moleculeData(i, j).id);
+            numMolecules++;
+        }
+    }
+    for (std::vector<int>& ids : reference)
+        std::sort(ids.begin(), ids.end());
+
+    coloured.sort(indexConverter);
+    scheduled.sort(indexConverter, scheduler);
+
+    // cells whose ids differ from the reference, and the number of molecules left over
+    auto compare = [&](const MoleculeContainer& container, int& remaining) {
+        int mismatches = 0;
+        remaining = 0;
+        for (int i = 0; i < container.getNumCells(); i++)
+        {
+            if(container.isHaloCell(i))
+                continue;
+            std::vector<int> ids;
+            for (int j = 0; j < container.linkedCellNumMolecules(i); j++)
+                ids.push_back(container.moleculeData(i, j).id);
+            std::sort(ids.begin(), ids.end());
+            if(ids != reference[i])
+                mismatches++;
+            remaining += ids.size();
+        }
+        return mismatches;
+    };
+    int colouredRemaining = 0, scheduledRemaining = 0;
+    const int colouredMismatches = compare(coloured, colouredRemaining);
+    const int scheduledMismatches = compare(scheduled, scheduledRemaining);
+    std::cout << "scheduled sort: " << scheduler.numTasks() << " cell tasks on " << scheduler.numWorkers() << " workers (" << scheduler.statistics().to_string() << "), "
+        << scheduledMismatches << " cells differ from a serial sort (coloured sort: " << colouredMismatches << "), molecules before " << numMolecules
+        << ", after " << scheduledRemaining << " (coloured sort: " << colouredRemaining << ")" << std::endl;
+    return scheduledMismatches == 0 && colouredMismatches == 0 && scheduledRemaining == numMolecules && colouredRemaining == numMolecules;
+}
+
+// cell, position and force of every interior molecule by id, independent of the slot order that sort leaves behind
+std::map<int, std::vector<double>> moleculesById(const MoleculeContainer& container)
+{
+    std::map<int, std::vector<double>> molecules;
+    for (int i = 0; i < container.getNumCells(); i++)
+    {
+        if(container.isHaloCell(i))
+            continue;
+        for (int j = 0; j < container.linkedCellNumMolecules(i); j++)
+        {
+            const Molecule& m = container.moleculeData(i, j);
+            molecules[m.id] = {static_cast<double>(i), m.pos[0], m.pos[1], m.pos[2], m.f[0], m.f[1], m.f[2]};
+        }
+    }
+    return molecules;
+}
+
+// two steps of a displaced periodic box, once as separate launches and once through a StepGraph
+// the atomic appends of sort leave slot orders, and with them the order of force sums, to thread timing, so molecules are matched by id:
+// every molecule has to be in the same cell, positions and packed entries have to agree and forces within rounding
+bool checkStepGraph(int domainSize, int numCellsPerDim, int cellSizeMolecules, const LennardJonesKernel& kernel, double cutoff)
+{
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<> dis(0, RAND_MAX);
+    IndexConverter indexConverter(domainSize, numCellsPerDim, 1);
+    MoleculeContainer launched(numCellsPerDim, cellSizeMolecules, gen, dis, MoleculeContainerOptions().setPeriodic());
+    MoleculeContainer graphed(numCellsPerDim, cellSizeMolecules, gen, dis, MoleculeContainerOptions().setPeriodic());
+    const size_t capacity = static_cast<size_t>(launched.getNumCells()) * 8 * cellSizeMolecules;
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> launchedOffsets("launchedOffsets", launched.getNumCells() + 1), graphedOffsets("graphedOffsets", graphed.getNumCells() + 1);
+    Kokkos::View<double*[4], Kokkos::LayoutRight, Kokkos::SharedSpace> launchedPacked("launchedPacked", capacity), graphedPacked("graphedPacked", capacity);
+    for (MoleculeContainer* container : {&launched, &graphed})
+    {
+        container->populateRandomly(domainSize);
+        container->reserve(8 * cellSizeMolecules);
+        container->bin(indexConverter);
+    }
+    PairTraversal<LennardJonesKernel> launchedTraversal(launched, kernel, cutoff);
+    PairTraversal<LennardJonesKernel> graphedTraversal(graphed, kernel, cutoff);
+    StepGraph<LennardJonesKernel> step(graphed, indexConverter, graphedTraversal, graphedOffsets, graphedPacked);
+
+    double deviation = 0;
+    for (int s = 0; s < 2; s++)
+    {
+        for (MoleculeContainer* container : {&launched, &graphed})
+            for (int i = 0; i < container->getNumCells(); i++)
+                if(!container->isHaloCell(i))
+                    for (int j = 0; j < container->linkedCellNumMolecules(i); j++)
+                        for (int d = 0; d < 3; d++)
+                            container->moleculeData(i, j).pos[d] += 0.9 * std::sin(container->moleculeData(i, j).id + 3.0 * d + s);
+        launched.sort(indexConverter);
+        launched.refreshHalo(indexConverter);
+        launched.clearForces();
+        launchedTraversal.traverseGlobal();
+        launched.packPositions(launchedOffsets, launchedPacked);
+        step.submit();
+
+        const std::map<int, std::vector<double>> launchedMolecules = moleculesById(launched), graphedMolecules = moleculesById(graphed);
+        if(launchedMolecules.size() != graphedMolecules.size())
+            return false;
+        for (const auto& entry : launchedMolecules)
+        {
+            const auto graphedEntry = graphedMolecules.find(entry.first);
+            if(graphedEntry == graphedMolecules.end() || graphedEntry->second[0] != entry.second[0])
+                return false;
+            deviation = std::max(deviation, maxDeviation(entry.second, graphedEntry->second));
+        }
+
+        const int numPacked = launchedOffsets(launched.getNumCells());
+        if(numPacked != graphedOffsets(graphed.getNumCells()))
+            return false;
+        std::map<int, std::vector<double>> launchedPositions, graphedPositions;
+        for (int i = 0; i < numPacked; i++)
+        {
+            launchedPositions[static_cast<int>(launchedPacked(i, 0))] = {launchedPacked(i, 1), launchedPacked(i, 2), launchedPacked(i, 3)};
+            graphedPositions[static_cast<int>(graphedPacked(i, 0))] = {graphedPacked(i, 1), graphedPacked(i, 2), graphedPacked(i, 3)};
+        }
+        for (const auto& entry : launchedPositions)
+        {
+            const auto graphedEntry = graphedPositions.find(entry.first);
+            if(graphedEntry == graphedPositions.end())
+                return false;
+            deviation = std::max(deviation, maxDeviation(entry.second, graphedEntry->second));
+        }
+    }
+    std::cout << "step graph: " << step.numKernels() << " kernels per submission, max deviation vs separate launches: " << deviation << std::endl;
+    return deviation < 1e-10;
+}
+
+int main(int argc, char* argv[])
+{
+    Kokkos::ScopeGuard guard(argc, argv);
+
+    std::mt19937 gen(1984);
+    std::uniform_int_distribution<> dis(0, RAND_MAX);
+
+    int domainSize = 16;
+    int numCellsPerDim = 8;
+    int cellSizeMolecules = 4;
+    int extraCellSpaceFactor = 3;
+    double cutoff = static_cast<double>(domainSize) / numCellsPerDim;
+
+    IndexConverter indexConverter(domainSize, numCellsPerDim);
+    MoleculeContainer container(numCellsPerDim, cellSizeMolecules, gen, dis);
+    container.populateRandomly(domainSize);
+    container.grow(cellSizeMolecules * extraCellSpaceFactor);
+    container.bin(indexConverter);
+
+    LennardJonesKernel kernel(1.0, 1.0);
+    PairTraversal<LennardJonesKernel> traversal(container, kernel, cutoff);
+    std::cout << "Scratch per team: " << traversal.scratchBytes() << " bytes, level " << traversal.scratchLevel() << std::endl;
+
+    container.clearForces();
+    auto t1 = std::chrono::high_resolution_clock::now();
+    traversal.traverseGlobal();
+    auto t2 = std::chrono::high_resolution_clock::now();
+    std::vector<double> globalForces = collectForces(container);
+    std::cout << "global: " << std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count() << " us" << std::endl;
+
+    if(traversal.scratchLevel() >= 0)
+    {
+        container.clearForces();
+        t1 = std::chrono::high_resolution_clock::now();
+        traversal.traverseScratch(traversal.scratchLevel());
+        t2 = std::chrono::high_resolution_clock::now();
+        std::cout << "scratch: " << std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count() << " us" << std::endl;
+        std::cout << "max deviation scratch vs global: " << maxDeviation(globalForces, collectForces(container)) << std::endl;
+    }
+
+    SimdPairTraversal<LennardJonesKernel> simdTraversal(container, kernel, cutoff);
+    container.clearForces();
+    t1 = std::chrono::high_resolution_clock::now();
+    simdTraversal.traverse();
+    t2 = std::chrono::high_resolution_clock::now();
+    double simdDeviation = maxDeviation(globalForces, collectForces(container));
+    std::cout << "simd (width " << SimdPairTraversal<LennardJonesKernel>::width << "): " << std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count() << " us" << std::endl;
+    std::cout << "max deviation simd vs scalar: " << simdDeviation << std::endl;
+    // summation order differs between the paths, results agree up to rounding
+    const double tolerance = 1e-10;
+    if(simdDeviation > tolerance)
+    {
+        std::cout << "simd forces exceed tolerance " << tolerance << std::endl;
+        return 1;
+    }
+
+    // periodic box: one molecule leaves the domain, binning wraps it back and the ghost layer supplies the periodic images
+    IndexConverter periodicIndexConverter(domainSize, numCellsPerDim, 1);
+    MoleculeContainer periodicContainer(numCellsPerDim, cellSizeMolecules, gen, dis, MoleculeContainerOptions().setPeriodic());
+    periodicContainer.populateRandomly(domainSize);
+    periodicContainer.grow(cellSizeMolecules * extraCellSpaceFactor);
+    int firstInterior = periodicIndexConverter.getIndex(0.5, 0.5, 0.5);
+    periodicContainer.moleculeData(firstInterior, 0).pos[0] = -0.5;
+    periodicContainer.moleculeData(firstInterior, 0).pos[1] = domainSize + 1.5;
+    periodicContainer.bin(periodicIndexConverter);
+    periodicContainer.refreshHalo(periodicIndexConverter);
+
+    PairTraversal<LennardJonesKernel> periodicTraversal(periodicContainer, kernel, cutoff);
+    periodicContainer.clearForces();
+    periodicTraversal.traverse();
+    std::vector<double> periodicForces = collectForces(periodicContainer);
+    double periodicDeviation = maxDeviation(minimumImageForces(periodicContainer, kernel, cutoff, domainSize), periodicForces);
+    std::cout << "max deviation periodic halo vs minimum image: " << periodicDeviation << std::endl;
+    SimdPairTraversal<LennardJonesKernel> periodicSimdTraversal(periodicContainer, kernel, cutoff);
+    periodicContainer.clearForces();
+    periodicSimdTraversal.traverse();
+    double periodicSimdDeviation = maxDeviation(periodicForces, collectForces(periodicContainer));
+    std::cout << "max deviation periodic simd vs scalar: " << periodicSimdDeviation << std::endl;
+    if(periodicDeviation > tolerance || periodicSimdDeviation > tolerance)
+    {
+        std::cout << "periodic forces exceed tolerance " << tolerance << std::endl;
+        return 1;
+    }
+
+    // sub-cutoff cells: the non-periodic box above binned into cells of rc, rc/2 and rc/3, and a periodic box of 12 binned into rc and rc/2
+    // periodic grids need a cell count divisible by the sort colour stride k+1
+    double halfShellDeviation = 0;
+    for (int cellsPerCutoff = 1; cellsPerCutoff <= 3; cellsPerCutoff++)
+        halfShellDeviation = std::max(halfShellDeviation, checkHalfShell(container, kernel, cutoff, domainSize, false, cellsPerCutoff));
+    const int periodicDomainSize = 12;
+    MoleculeContainer smallPeriodicContainer(static_cast<int>(periodicDomainSize / cutoff), cellSizeMolecules, gen, dis, MoleculeContainerOptions().setPeriodic());
+    smallPeriodicContainer.populateRandomly(periodicDomainSize);
+    for (int cellsPerCutoff = 1; cellsPerCutoff <= 2; cellsPerCutoff++)
+        halfShellDeviation = std::max(halfShellDeviation, checkHalfShell(smallPeriodicContainer, kernel, cutoff, periodicDomainSize, true, cellsPerCutoff));
+    if(halfShellDeviation > tolerance)
+    {
+        std::cout << "half shell forces exceed tolerance " << tolerance << std::endl;
+        return 1;
+    }
+
+    for (int bits : {16, 32})
+    {
+        if(!checkQuantised(bits, periodicDomainSize, static_cast<int>(periodicDomainSize / cutoff), cellSizeMolecules, kernel, cutoff))
+        {
+            std::cout << "quantised positions exceed their error bound" << std::endl;
+            return 1;
+        }
+    }
+
+    if(!checkScheduledSort(periodicDomainSize, static_cast<int>(periodicDomainSize / cutoff), cellSizeMolecules))
+    {
+        std::cout << "scheduled or coloured sort differs from a serial sort" << std::endl;
+        return 1;
+    }
+
+    if(!checkStepGraph(periodicDomainSize, static_cast<int>(periodicDomainSize / cutoff), cellSizeMolecules, kernel, cutoff))
+    {
+        std::cout << "step graph differs from separate launches" << std::endl;
+        return 1;
+    }
+    return 0;
+}
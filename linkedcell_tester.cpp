@@ -1,5 +1,6 @@
 #include <iostream>
 #include <random>
+#include <algorithm>
 
 #include <Kokkos_Core.hpp>
 
@@ -7,6 +8,8 @@
 #include <linked_cells.hpp>
 #include <molecule.hpp>
 #include <index_converter.hpp>
+#include <cell_grid_tuner.hpp>
+#include <molecule_ensemble.hpp>
 
 int main(int argc, char* argv[])
 {
@@ -25,6 +28,36 @@ int main(int argc, char* argv[])
     int totNumCells = numCellsPerDim * numCellsPerDim * numCellsPerDim;
     int cellSizeMolecules = 2;
     int extraCellSpaceFactor = 3;
+    int grownCellSize = cellSizeMolecules * extraCellSpaceFactor;
+
+    // "--autotune" picks grid and capacity from trial runs on the molecules of a live system on the default grid,
+    // later runs of the same system reuse the stored choice
+    const std::string tunedSettingsFile = "cell_grid_settings.txt";
+    CellGridSettings settings;
+    if(argc > 1 && std::string(argv[1]) == "--autotune")
+    {
+        MoleculeContainer live(numCellsPerDim, cellSizeMolecules, gen, dis);
+        live.populateRandomly(domainSizeVolume);
+        live.bin(IndexConverter(domainSizeVolume, numCellsPerDim));
+        Kokkos::fence();
+        CellGridTuner tuner(domainSizeVolume, cellSizeVolume, gen, dis);
+        settings = tuner.tune(live, true);
+        if(!settings.save(tunedSettingsFile))
+            std::cout << "No admissible grid found, settings not saved" << std::endl;
+    }
+    else if(settings.load(tunedSettingsFile, domainSizeVolume, cellSizeVolume, totNumCells * cellSizeMolecules))
+    {
+        std::cout << "Loaded tuned settings: " << settings.to_string() << std::endl;
+    }
+    if(settings.numCellsPerDim > 0)
+    {
+        int numMolecules = totNumCells * cellSizeMolecules;
+        numCellsPerDim = settings.numCellsPerDim;
+        totNumCells = numCellsPerDim * numCellsPerDim * numCellsPerDim;
+        cellSizeMolecules = (numMolecules + totNumCells - 1) / totNumCells;
+        // one spare slot for the molecule inserted further down
+        grownCellSize = std::max(settings.cellSize, cellSizeMolecules) + 1;
+    }
 
     IndexConverter indexConverter(domainSizeVolume, numCellsPerDim);
     MoleculeContainer container(numCellsPerDim, cellSizeMolecules, gen, dis);
@@ -34,8 +67,9 @@ int main(int argc, char* argv[])
 
     container.populateRandomly(domainSizeVolume); 
     container.printData();
-    container.grow(cellSizeMolecules * extraCellSpaceFactor);
-    container.sort(indexConverter);
+    container.grow(grownCellSize);
+    // molecules start anywhere in the domain, farther from their cells than sort handles
+    container.bin(indexConverter);
     Kokkos::fence();
     container.printData();
 
@@ -50,7 +84,8 @@ int main(int argc, char* argv[])
     (*it).pos[0] = 1;
     (*it).pos[1] = 1;
     (*it).pos[2] = 1;
-    container.sort(indexConverter);
+    // on a tuned grid the molecule may have jumped several cells
+    container.bin(indexConverter);
     container.printData();
 
     Molecule m(50,0.5,0.5,0.5);
@@ -60,5 +95,145 @@ int main(int argc, char* argv[])
     container.testTestData();
     container.printData();
 
+    container.enableIdIndex(std::max(container.getNumCells() * container.getCellSize(), m.id));
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> ids("ids", 3);
+    Kokkos::View<int*[2], Kokkos::LayoutRight, Kokkos::SharedSpace> locations("locations", 3);
+    ids(0) = 0;
+    ids(1) = 1;
+    ids(2) = m.id;
+    container.lookup(ids, locations);
+    std::cout << "Id lookup:" << std::endl;
+    for (int i = 0; i < 3; i++)
+        std::cout << "id " << ids(i) << " -> cell " << locations(i, 0) << " slot " << locations(i, 1) << std::endl;
+
+    // the index has to follow every move: a sort after displacing all molecules, a removal and re-insertion, holes and compaction
+    const int maxId = std::max(container.getNumCells() * container.getCellSize(), m.id);
+    for (int i = 0; i < container.getNumCells(); i++)
+        for (int j = 0; j < container.linkedCellNumMolecules(i); j++)
+            for (int d = 0; d < 3; d++)
+                container.moleculeData(i, j).pos[d] = std::min(std::max(container.moleculeData(i, j).pos[d] + 0.4 * indexConverter.cellWidth() * std::sin(container.moleculeData(i, j).id + 2.0 * d), 0.0), domainSizeVolume - 1e-9);
+    // room for the projected sort peak and the molecule re-inserted below, so that sort, insert and compact reallocate no further
+    const AllocationStatistics& statistics = container.allocationStatistics();
+    const size_t reallocationsBefore = statistics.allocations + statistics.reuses;
+    container.reserve(CellGridTuner::projectOccupancy(container, indexConverter).peakOccupancy + 1);
+    const size_t reallocationsReserved = statistics.allocations + statistics.reuses;
+    container.sort(indexConverter);
+    for (int i = 0; i < container.getNumCells(); i++)
+    {
+        if(container.linkedCellNumMolecules(i) == 0)
+            continue;
+        Molecule moved = container.moleculeData(i, 0);
+        container[i].remove(0);
+        container[(i + 1) % container.getNumCells()].insert(moved);
+        break;
+    }
+    container.makeRandomHoles();
+    // random holes may all fall into free slots, every third molecule becomes one as well
+    // the selector may only pick kernels that keep the surviving molecules of every cell in their order
+    std::vector<std::vector<int>> survivors(container.getNumCells());
+    for (int i = 0; i < container.getNumCells(); i++)
+    {
+        for (int j = 0; j < container.linkedCellNumMolecules(i); j++)
+        {
+            Molecule& molecule = container.moleculeData(i, j);
+            if(!molecule.dirty && molecule.id % 3 == 0)
+            {
+                container.moleculeLocations.clear(molecule.id);
+                molecule.dirty = true;
+            }
+            if(!molecule.dirty)
+                survivors[i].push_back(molecule.id);
+        }
+    }
+    CompactionSelector compactionSelector;
+    container.compact(compactionSelector, true, true);
+    int orderErrors = 0;
+    for (int i = 0; i < container.getNumCells(); i++)
+    {
+        std::vector<int> kept;
+        for (int j = 0; j < container.linkedCellNumMolecules(i); j++)
+            kept.push_back(container.moleculeData(i, j).id);
+        orderErrors += kept != survivors[i];
+    }
+    std::cout << "Order-keeping compaction: " << orderErrors << " cells out of order" << std::endl;
+    if(orderErrors > 0)
+        return 1;
+    int indexErrors = 0;
+    int liveMolecules = 0;
+    for (int i = 0; i < container.getNumCells(); i++)
+    {
+        for (int j = 0; j < container.linkedCellNumMolecules(i); j++)
+        {
+            liveMolecules++;
+            const int id = container.moleculeData(i, j).id;
+            if(container.moleculeLocations.cell(id) != i || container.moleculeLocations.slot(id) != j)
+                indexErrors++;
+        }
+    }
+    for (int id = 0; id <= maxId; id++)
+    {
+        const int cell = container.moleculeLocations.cell(id), slot = container.moleculeLocations.slot(id);
+        if(cell >= 0 && (slot >= container.linkedCellNumMolecules(cell) || container.moleculeData(cell, slot).id != id))
+            indexErrors++;
+    }
+    std::cout << "Id index after sort, remove, insert and compact: " << liveMolecules << " live molecules, " << indexErrors << " errors" << std::endl;
+    if(indexErrors > 0)
+        return 1;
+    std::cout << "Reallocations by reserve: " << reallocationsReserved - reallocationsBefore << ", by sort, insert and compact: "
+        << statistics.allocations + statistics.reuses - reallocationsReserved << std::endl;
+    if(reallocationsReserved - reallocationsBefore > 1 || statistics.allocations + statistics.reuses != reallocationsReserved)
+        return 1;
+
+    container.shrink_to_fit();
+    std::cout << "Capacity after shrink_to_fit: " << container.getCellSize() << std::endl;
+    std::cout << "Reallocations: " << container.allocationStatistics().to_string() << std::endl;
+
+    // three independent systems side by side of unit cells, the last one at an eighth of the density, every operation is one launch over all of them
+    // with at least 4 cells per dimension a sort colour holds cells that move molecules into the same neighbour
+    const int ensembleCellsPerDim = std::max(4, numCellsPerDim);
+    MoleculeEnsemble ensemble(3, ensembleCellsPerDim, cellSizeMolecules, ensembleCellsPerDim);
+    ensemble.domainSizes(2) = 2 * ensembleCellsPerDim;
+    ensemble.populateRandomly(cellSizeMolecules);
+    ensemble.reserve(ensemble.projectPeakOccupancy());
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> ensembleCounts("ensembleCounts", ensemble.getNumSystems());
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> ensembleOccupancy("ensembleOccupancy", ensemble.getNumSystems());
+    Kokkos::View<double*, Kokkos::LayoutRight, Kokkos::SharedSpace> ensembleEnergies("ensembleEnergies", ensemble.getNumSystems());
+    // sort and compact must not lose or duplicate molecules: the count before sort equals the count after it, which equals the count after compact plus the holes
+    std::vector<int> countsBeforeSort(ensemble.getNumSystems()), countsAfterSort(ensemble.getNumSystems()), holes(ensemble.getNumSystems(), 0);
+    ensemble.countMolecules(ensembleCounts);
+    for (int s = 0; s < ensemble.getNumSystems(); s++)
+        countsBeforeSort[s] = ensembleCounts(s);
+    ensemble.sort();
+    ensemble.countMolecules(ensembleCounts);
+    for (int s = 0; s < ensemble.getNumSystems(); s++)
+        countsAfterSort[s] = ensembleCounts(s);
+    ensemble.makeRandomHoles(0.25);
+    for (int s = 0; s < ensemble.getNumSystems(); s++)
+        for (int i = 0; i < ensemble.getNumCells(); i++)
+            for (int j = 0; j < ensemble.linkedCellNumMolecules(s, i); j++)
+                if(ensemble.getMoleculeAt(s, i, j).dirty)
+                    holes[s]++;
+    ensemble.compact();
+    ensemble.countMolecules(ensembleCounts);
+    ensemble.maxOccupancy(ensembleOccupancy);
+    ensemble.kineticEnergy(ensembleEnergies);
+    int lost = 0;
+    for (int s = 0; s < ensemble.getNumSystems(); s++)
+        if(countsAfterSort[s] != countsBeforeSort[s] || ensembleCounts(s) + holes[s] != countsAfterSort[s])
+            lost++;
+    int misplaced = 0;
+    for (int s = 0; s < ensemble.getNumSystems(); s++)
+    {
+        const IndexConverter systemIndexConverter = ensemble.getIndexConverter(s);
+        for (int i = 0; i < ensemble.getNumCells(); i++)
+            for (int j = 0; j < ensemble.linkedCellNumMolecules(s, i); j++)
+                if(ensemble.getMoleculeAt(s, i, j).dirty || !systemIndexConverter.isInIndex(ensemble.getMoleculeAt(s, i, j).pos, i))
+                    misplaced++;
+        std::cout << "Ensemble system " << s << ": " << ensembleCounts(s) << " molecules, max occupancy " << ensembleOccupancy(s) << ", kinetic energy " << ensembleEnergies(s) << std::endl;
+    }
+    std::cout << "Ensemble misplaced molecules: " << misplaced << ", systems whose count is not conserved: " << lost << std::endl;
+    if(misplaced > 0 || lost > 0)
+        return 1;
+
     return 0;
 }
\ No newline at end of file
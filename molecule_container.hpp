@@ -7,38 +7,214 @@
 #include <sstream>
 #include <algorithm>
 #include <numeric>
+#include <cmath>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include <Kokkos_Core.hpp>
 
 #include <linked_cells.hpp>
 #include <molecule.hpp>
 #include <index_converter.hpp>
+#include <view_pool.hpp>
+#include <molecule_location_index.hpp>
+#include <quantised_positions.hpp>
+#include <cell_task_scheduler.hpp>
+#include <cell_operations.hpp>
+#include <compaction_selector.hpp>
+
+// container operations run on the given execution space instance and only fence that instance,
+// independent operations can therefore overlap on different instances (see PartitionedScheduler)
+// optional settings of a MoleculeContainer, e.g. MoleculeContainerOptions().setPeriodic().setCellsPerCutoff(2)
+struct MoleculeContainerOptions
+{
+    // a periodic container carries cellsPerCutoff layers of ghost cells around the numCellsPerDim^3 interior cells,
+    // ghost cells hold shifted copies of the opposite boundary cells after refreshHalo
+    bool periodic = false;
+    // asks the kernel for transparent huge pages for moleculeData
+    bool hugePages = false;
+    // k declares cells with an edge of cutoff/k, sort then colours with a stride of k+1 instead of 2
+    int cellsPerCutoff = 1;
+
+    MoleculeContainerOptions& setPeriodic(bool value = true) { periodic = value; return *this; }
+    MoleculeContainerOptions& setHugePages(bool value = true) { hugePages = value; return *this; }
+    MoleculeContainerOptions& setCellsPerCutoff(int value) { cellsPerCutoff = value; return *this; }
+
+    int haloWidth() const { return periodic ? cellsPerCutoff : 0; }
+};
 
 class MoleculeContainer
 {
 public:
-    MoleculeContainer(int numCellsPerDim, int cellSize, std::mt19937 gen, std::uniform_int_distribution<> dis) : _numCellsPerDim(numCellsPerDim), _numCells(numCellsPerDim*numCellsPerDim*numCellsPerDim), _cellSize(cellSize), _gen(gen), 
-        _dis(dis), moleculeData("moleculeData", numCellsPerDim*numCellsPerDim*numCellsPerDim, cellSize), linkedCellNumMolecules("linkedCellNumMolecules", numCellsPerDim*numCellsPerDim*numCellsPerDim), linkedCells("linkedCells", numCellsPerDim*numCellsPerDim*numCellsPerDim)
-        {}
+    using ExecutionSpace = Kokkos::DefaultExecutionSpace;
+    using MoleculeView = Kokkos::View<Molecule**, Kokkos::LayoutRight, Kokkos::SharedSpace>;
+    // kernels launched with CellPolicy over all cells (compact, clearForces, refreshHalo, pack, reallocate) share this static cell-to-thread mapping,
+    // so pages first-touched by a thread stay local to it; the sort colours map iterations to strided subsets of cells and the pair traversals
+    // are team policies, neither follows the first-touch mapping
+    using CellPolicy = Kokkos::RangePolicy<ExecutionSpace, Kokkos::Schedule<Kokkos::Static>>;
+
+    // memory is allocated uninitialised and first touched in parallel
+    MoleculeContainer(int numCellsPerDim, int cellSize, std::mt19937 gen, std::uniform_int_distribution<> dis, const MoleculeContainerOptions& options = MoleculeContainerOptions()) : _numCellsPerDim(numCellsPerDim),
+        _haloWidth(options.haloWidth()), _numCellsPerDimWithHalo(numCellsPerDim + 2*_haloWidth), _numCells(numCellsWithHalo(numCellsPerDim, options.haloWidth())), _cellSize(cellSize), _gen(gen), 
+        _dis(dis), moleculeData(Kokkos::view_alloc(Kokkos::WithoutInitializing, "moleculeData"), numCellsWithHalo(numCellsPerDim, options.haloWidth()), cellSize),
+        linkedCellNumMolecules(Kokkos::view_alloc(Kokkos::WithoutInitializing, "linkedCellNumMolecules"), numCellsWithHalo(numCellsPerDim, options.haloWidth())),
+        linkedCells("linkedCells", numCellsWithHalo(numCellsPerDim, options.haloWidth()))
+        {
+            assert(options.cellsPerCutoff >= 1);
+            // wrapped molecules move between cells 0 and numCellsPerDim-1, which only keeps the colour scheme of sort intact if the stride divides the count
+            assert(!options.periodic || numCellsPerDim % (options.cellsPerCutoff + 1) == 0);
+            _cellsPerCutoff = options.cellsPerCutoff;
+            _hugePages = options.hugePages;
+            firstTouch(moleculeData);
+        }
 
+    // grows the capacity to at least cellSize, geometrically by the growth factor so that repeated small growths copy rarely
+    // a no-op if the capacity already suffices
     void grow(int cellSize)
     {
-        assert(_cellSize <= cellSize);
-        _cellSize = cellSize;
-        Kokkos::resize(moleculeData, _numCells, _cellSize);
+        if(cellSize <= _cellSize)
+            return;
+        reallocate(std::max(cellSize, static_cast<int>(std::ceil(_cellSize * _growthFactor))));
         // new space created is filled with garbage data, so size of _linkedCell does not change
     }
 
+    // grows the capacity to exactly cellSize if it is smaller
+    void reserve(int cellSize)
+    {
+        if(cellSize > _cellSize)
+            reallocate(cellSize);
+    }
+
+    // shrinks the capacity to the fullest cell and returns the memory held for reuse
+    void shrink_to_fit()
+    {
+        auto linkedCellLocal(linkedCellNumMolecules);
+        int maxOccupancy = 0;
+        Kokkos::parallel_reduce(CellPolicy(0, _numCells), KOKKOS_LAMBDA(const int i, int& localMax) {
+            if(linkedCellLocal(i) > localMax) localMax = linkedCellLocal(i);
+        }, Kokkos::Max<int>(maxOccupancy));
+        if(std::max(maxOccupancy, 1) < _cellSize)
+            reallocate(std::max(maxOccupancy, 1));
+        _moleculePool.clear();
+    }
+
+    void setGrowthFactor(double growthFactor)
+    {
+        assert(growthFactor >= 1);
+        _growthFactor = growthFactor;
+    }
+
+    // reallocations of moleculeData since construction
+    const AllocationStatistics& allocationStatistics() const { return _moleculePool.statistics(); }
+
     KOKKOS_INLINE_FUNCTION void insert(int cellIdx, Molecule& molecule)
     {
+        moleculeLocations.set(molecule.id, cellIdx, linkedCellNumMolecules(cellIdx));
+        if(quantisedPositions.enabled()) quantisedPositions.encode(cellIdx, linkedCellNumMolecules(cellIdx), molecule.pos);
         moleculeData(cellIdx, linkedCellNumMolecules(cellIdx)) = molecule;
         linkedCellNumMolecules(cellIdx) += 1;
     }
 
     KOKKOS_INLINE_FUNCTION void remove(int cellIdx, int moleculeIdx)
     {
+        moleculeLocations.clear(moleculeData(cellIdx, moleculeIdx).id);
         moleculeData(cellIdx, moleculeIdx) = moleculeData(cellIdx, linkedCellNumMolecules(cellIdx) - 1);
+        if(quantisedPositions.enabled()) quantisedPositions.copy(cellIdx, linkedCellNumMolecules(cellIdx) - 1, cellIdx, moleculeIdx);
         linkedCellNumMolecules(cellIdx) -= 1;
+        if(moleculeIdx < linkedCellNumMolecules(cellIdx))
+            moleculeLocations.set(moleculeData(cellIdx, moleculeIdx).id, cellIdx, moleculeIdx);
+    }
+
+    // switches position storage to bits (16 or 32) wide fixed-point codes relative to the cell origin, encoding the current positions,
+    // which must be sorted so that every molecule lies within a cell width of its cell
+    // sort, compact, refreshHalo, packPositions and the pair traversals then read and write the codes, Molecule::pos goes stale
+    // until disableQuantisedPositions, positions are accessed through getPosition and setPosition, also for molecules written through LinkedCell
+    void enableQuantisedPositions(const IndexConverter& indexConverter, int bits)
+    {
+        assert(indexConverter.haloWidth == _haloWidth && indexConverter.numCellsPerDim == _numCellsPerDim);
+        quantisedPositions = QuantisedPositions(bits, indexConverter.cellWidth(), _numCellsPerDimWithHalo, _haloWidth, _numCells, _cellSize);
+        _generation++;
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const QuantisedPositions quantised = quantisedPositions;
+        Kokkos::parallel_for(CellPolicy(0, _numCells), KOKKOS_LAMBDA(const unsigned int i) {
+            for (int j = 0; j < linkedCellLocal(i); j++)
+                quantised.encode(i, j, moleculeDataLocal(i, j).pos);
+        });
+        Kokkos::fence();
+    }
+
+    // decodes the positions back into Molecule::pos and drops the codes
+    void disableQuantisedPositions()
+    {
+        if(!quantisedPositions.enabled())
+            return;
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const QuantisedPositions quantised = quantisedPositions;
+        Kokkos::parallel_for(CellPolicy(0, _numCells), KOKKOS_LAMBDA(const unsigned int i) {
+            for (int j = 0; j < linkedCellLocal(i); j++)
+                quantised.decode(i, j, moleculeDataLocal(i, j).pos);
+        });
+        Kokkos::fence();
+        quantisedPositions = QuantisedPositions();
+        _generation++;
+    }
+
+    KOKKOS_INLINE_FUNCTION void getPosition(int cellIdx, int moleculeIdx, double pos[3]) const
+    {
+        quantisedPositions.read(moleculeData, cellIdx, moleculeIdx, pos);
+    }
+
+    // a position outside the cell is only kept exactly enough if it lies within one cell width of it, sort moves the molecule afterwards
+    KOKKOS_INLINE_FUNCTION void setPosition(int cellIdx, int moleculeIdx, const double pos[3]) const
+    {
+        quantisedPositions.write(moleculeData, cellIdx, moleculeIdx, pos);
+    }
+
+    // starts tracking the location of every molecule with an id up to maxId, ghost copies are never tracked
+    void enableIdIndex(int maxId)
+    {
+        moleculeLocations.locations = Kokkos::View<int*[2], Kokkos::LayoutRight, Kokkos::SharedSpace>(Kokkos::view_alloc(Kokkos::WithoutInitializing, "moleculeLocations"), maxId + 1);
+        Kokkos::deep_copy(moleculeLocations.locations, -1);
+        _generation++;
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const MoleculeLocationIndex locations = moleculeLocations;
+        const int numCellsPerDimWithHalo = _numCellsPerDimWithHalo;
+        const int haloWidth = _haloWidth;
+        const int last = _numCellsPerDim + _haloWidth;
+        Kokkos::parallel_for(CellPolicy(0, _numCells), KOKKOS_LAMBDA(const unsigned int i) {
+            const int x = i % numCellsPerDimWithHalo, y = (i / numCellsPerDimWithHalo) % numCellsPerDimWithHalo, z = i / (numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+            if(x < haloWidth || y < haloWidth || z < haloWidth || x >= last || y >= last || z >= last)
+                return;
+            for (int j = 0; j < linkedCellLocal(i); j++)
+                locations.set(moleculeDataLocal(i, j).id, i, j);
+        });
+        Kokkos::fence();
+    }
+
+    void disableIdIndex()
+    {
+        moleculeLocations = MoleculeLocationIndex();
+        _generation++;
+    }
+
+    // writes (cell, slot) of every requested id to locations, (-1, -1) for ids that are not stored or not tracked
+    void lookup(const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>& ids, const Kokkos::View<int*[2], Kokkos::LayoutRight, Kokkos::SharedSpace>& locations,
+        const ExecutionSpace& space = ExecutionSpace()) const
+    {
+        const MoleculeLocationIndex index = moleculeLocations;
+        Kokkos::parallel_for(Kokkos::RangePolicy<ExecutionSpace>(space, 0, ids.extent(0)), KOKKOS_LAMBDA(const unsigned int i) {
+            locations(i, 0) = index.cell(ids(i));
+            locations(i, 1) = index.slot(ids(i));
+        });
+        space.fence();
     }
 
     KOKKOS_FUNCTION void clearLinkedCell(int cellIdx)
@@ -46,63 +222,519 @@ public:
         linkedCellNumMolecules(cellIdx) = 0;
     }
 
-    void sort(const IndexConverter& indexConverter)
+    // kernels of the step operations as functors, so that they can be launched directly or captured as nodes of a StepGraph
+    // they hold Views by value, kernels built before a reallocation keep working on the old memory
+
+    // the cells for the shared bodies of CellOperations, positions are read through the quantised codes and every move keeps the codes and the id index in step
+    struct Cells
     {
-        Kokkos::fence();
-        //find red-black cells
-        for (int z = 0; z < 2; z++)
+        KOKKOS_INLINE_FUNCTION int& count(const int cell) const { return linkedCellNumMolecules(cell); }
+        KOKKOS_INLINE_FUNCTION Molecule& at(const int cell, const int slot) const { return moleculeData(cell, slot); }
+
+        // periodic containers wrap the position back into the domain first
+        KOKKOS_INLINE_FUNCTION int target(const int cell, const int slot, double pos[3]) const
+        {
+            quantised.read(moleculeData, cell, slot, pos);
+            if(indexConverter.isPeriodic())
+            {
+                indexConverter.wrap(pos);
+                quantised.write(moleculeData, cell, slot, pos);
+            }
+            const int index = indexConverter.getIndex(pos);
+            assert(reach < 0 || withinReach(cell, index));
+            return index;
+        }
+
+        // whether target lies at most reach cells from cell along every dimension, across the periodic boundary if there is one
+        KOKKOS_INLINE_FUNCTION bool withinReach(const int cell, const int target) const
         {
-            for (int y = 0; y < 2; y++)
+            const int n = indexConverter.numCellsPerDimWithHalo();
+            int a = cell, b = target;
+            for (int d = 0; d < 3; d++)
             {
-                for (int x = 0; x < 2; x++)
+                int distance = a % n - b % n;
+                distance = distance < 0 ? -distance : distance;
+                if(indexConverter.isPeriodic() && indexConverter.numCellsPerDim - distance < distance)
+                    distance = indexConverter.numCellsPerDim - distance;
+                if(distance > reach)
+                    return false;
+                a /= n;
+                b /= n;
+            }
+            return true;
+        }
+
+        // codes are re-encoded relative to the new cell
+        KOKKOS_INLINE_FUNCTION void placed(const int cell, const int slot, const double pos[3]) const
+        {
+            if(quantised.enabled()) quantised.encode(cell, slot, pos);
+            locations.set(moleculeData(cell, slot).id, cell, slot);
+        }
+
+        KOKKOS_INLINE_FUNCTION void copied(const int cell, const int from, const int to) const
+        {
+            if(quantised.enabled()) quantised.copy(cell, from, cell, to);
+        }
+
+        KOKKOS_INLINE_FUNCTION void relocated(const int cell, const int slot) const
+        {
+            locations.set(moleculeData(cell, slot).id, cell, slot);
+        }
+
+        MoleculeView moleculeData;
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> linkedCellNumMolecules;
+        MoleculeLocationIndex locations;
+        QuantisedPositions quantised;
+        IndexConverter indexConverter;
+        // largest move target checks in debug builds, negative for none
+        int reach = -1;
+    };
+
+    // one colour of sort, cells of a colour are stride apart along every dimension, so that no two of them exchange molecules,
+    // two of them may still move molecules into the cell between them, which CellOperations appends atomically
+    struct SortColourKernel
+    {
+        KOKKOS_INLINE_FUNCTION void operator()(const int j) const
+        {
+            // compute index of the current cell
+            int index = 0;
+            int helpIndex1 = j;
+            int helpIndex2 = 0;
+            // determine plane within traversed block
+            helpIndex2 = helpIndex1 / (lengthVector[0] * lengthVector[1]);
+            // save rest of index in helpIndex1
+            helpIndex1 = helpIndex1 - helpIndex2 * (lengthVector[0] * lengthVector[1]);
+            // compute contribution to index
+            index += (haloWidth + stride * helpIndex2 + colour[2]) * numCellsPerDim * numCellsPerDim;
+            // determine plane within traversed block
+            helpIndex2 = helpIndex1 / lengthVector[0];
+            // save rest of index in helpIndex1
+            helpIndex1 = helpIndex1 - helpIndex2 * lengthVector[0];
+            // compute contribution to index
+            index += (haloWidth + stride * helpIndex2 + colour[1]) * numCellsPerDim;
+            // compute contribution for last dimension
+            index += (haloWidth + stride * helpIndex1 + colour[0]);
+            sortCell(index);
+        }
+
+        // moves the molecules of one interior cell that left it, writes to every cell a molecule moved into
+        KOKKOS_INLINE_FUNCTION void sortCell(const int index) const
+        {
+            CellOperations::sortCell(cells, index);
+        }
+
+        // number of cells of this colour
+        int length() const { return lengthVector[0] * lengthVector[1] * lengthVector[2]; }
+
+        Cells cells;
+        int colour[3], lengthVector[3];
+        int stride, haloWidth, numCellsPerDim;
+    };
+
+    // refills ghost cell i from the interior cell it mirrors, interior cells are left alone
+    struct RefreshHaloKernel
+    {
+        KOKKOS_INLINE_FUNCTION void operator()(const int i) const
+        {
+            const int coordinate[3] = {i % numCellsPerDimWithHalo, (i / numCellsPerDimWithHalo) % numCellsPerDimWithHalo, i / (numCellsPerDimWithHalo * numCellsPerDimWithHalo)};
+            int source = 0;
+            double shift[3];
+            bool ghost = false;
+            for (int d = 2; d >= 0; d--)
+            {
+                int interior = coordinate[d] - haloWidth;
+                shift[d] = 0;
+                if(interior < 0) { interior += numCellsPerDim; shift[d] = -domainSize; ghost = true; }
+                else if(interior >= numCellsPerDim) { interior -= numCellsPerDim; shift[d] = domainSize; ghost = true; }
+                source = source * numCellsPerDimWithHalo + interior + haloWidth;
+            }
+            if(!ghost)
+                return;
+            for (int j = 0; j < linkedCellNumMolecules(source); j++)
+            {
+                moleculeData(i, j) = moleculeData(source, j);
+                moleculeData(i, j).pos[0] += shift[0];
+                moleculeData(i, j).pos[1] += shift[1];
+                moleculeData(i, j).pos[2] += shift[2];
+                if(quantised.enabled()) quantised.copy(source, j, i, j);
+            }
+            linkedCellNumMolecules(i) = linkedCellNumMolecules(source);
+        }
+
+        MoleculeView moleculeData;
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> linkedCellNumMolecules;
+        QuantisedPositions quantised;
+        int numCellsPerDim, numCellsPerDimWithHalo, haloWidth;
+        double domainSize;
+    };
+
+    struct ClearForcesKernel
+    {
+        KOKKOS_INLINE_FUNCTION void operator()(const int i) const
+        {
+            for (int j = 0; j < linkedCellNumMolecules(i); j++)
+            {
+                moleculeData(i, j).f[0] = 0;
+                moleculeData(i, j).f[1] = 0;
+                moleculeData(i, j).f[2] = 0;
+            }
+        }
+
+        MoleculeView moleculeData;
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> linkedCellNumMolecules;
+    };
+
+    // exclusive scan of the interior cell counts into offsets, offsets(numCells) receives the total
+    struct PackOffsetsKernel
+    {
+        KOKKOS_INLINE_FUNCTION void operator()(const int i, int& update, const bool final) const
+        {
+            const int x = i % numCellsPerDimWithHalo, y = (i / numCellsPerDimWithHalo) % numCellsPerDimWithHalo, z = i / (numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+            const int last = numCellsPerDim + haloWidth;
+            const bool halo = x < haloWidth || y < haloWidth || z < haloWidth || x >= last || y >= last || z >= last;
+            if(final) offsets(i) = update;
+            update += halo ? 0 : linkedCellNumMolecules(i);
+            if(final && i == numCells - 1) offsets(numCells) = update;
+        }
+
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> linkedCellNumMolecules;
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> offsets;
+        int numCells, numCellsPerDim, numCellsPerDimWithHalo, haloWidth;
+    };
+
+    struct PackKernel
+    {
+        KOKKOS_INLINE_FUNCTION void operator()(const int i) const
+        {
+            if(offsets(i + 1) == offsets(i))
+                return;
+            for (int j = 0; j < linkedCellNumMolecules(i); j++)
+            {
+                double pos[3];
+                quantised.read(moleculeData, i, j, pos);
+                buffer(offsets(i) + j, 0) = moleculeData(i, j).id;
+                buffer(offsets(i) + j, 1) = pos[0];
+                buffer(offsets(i) + j, 2) = pos[1];
+                buffer(offsets(i) + j, 3) = pos[2];
+            }
+        }
+
+        MoleculeView moleculeData;
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> linkedCellNumMolecules;
+        QuantisedPositions quantised;
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> offsets;
+        Kokkos::View<double*[4], Kokkos::LayoutRight, Kokkos::SharedSpace> buffer;
+    };
+
+    // colours of sort, stride^3 with a stride of cellsPerCutoff+1
+    int numSortColours() const { return (_cellsPerCutoff + 1) * (_cellsPerCutoff + 1) * (_cellsPerCutoff + 1); }
+
+    // only target needs the index converter, compact passes a default one
+    Cells cellAccess(const IndexConverter& indexConverter) const
+    {
+        Cells cells;
+        cells.moleculeData = moleculeData;
+        cells.linkedCellNumMolecules = linkedCellNumMolecules;
+        cells.locations = moleculeLocations;
+        cells.quantised = quantisedPositions;
+        cells.indexConverter = indexConverter;
+        return cells;
+    }
+
+    SortColourKernel sortColourKernel(const IndexConverter& indexConverter, int colour) const
+    {
+        assert(indexConverter.haloWidth == _haloWidth && indexConverter.numCellsPerDim == _numCellsPerDim);
+        //find red-black cells, generalised to a stride of cellsPerCutoff+1 for cells narrower than the cutoff
+        const int stride = _cellsPerCutoff + 1;
+        SortColourKernel kernel;
+        kernel.colour[0] = colour % stride;
+        kernel.colour[1] = (colour / stride) % stride;
+        kernel.colour[2] = colour / (stride * stride);
+        for (int d = 0; d < 3; d++)
+            kernel.lengthVector[d] = (_numCellsPerDim - kernel.colour[d] + stride - 1) / stride;
+        kernel.cells = cellAccess(indexConverter);
+        kernel.cells.reach = _cellsPerCutoff;
+        kernel.stride = stride;
+        kernel.haloWidth = _haloWidth;
+        kernel.numCellsPerDim = _numCellsPerDimWithHalo;
+        return kernel;
+    }
+
+    RefreshHaloKernel refreshHaloKernel(const IndexConverter& indexConverter) const
+    {
+        RefreshHaloKernel kernel;
+        kernel.moleculeData = moleculeData;
+        kernel.linkedCellNumMolecules = linkedCellNumMolecules;
+        kernel.quantised = quantisedPositions;
+        kernel.numCellsPerDim = _numCellsPerDim;
+        kernel.numCellsPerDimWithHalo = _numCellsPerDimWithHalo;
+        kernel.haloWidth = _haloWidth;
+        kernel.domainSize = indexConverter.domainSize;
+        return kernel;
+    }
+
+    ClearForcesKernel clearForcesKernel() const
+    {
+        ClearForcesKernel kernel;
+        kernel.moleculeData = moleculeData;
+        kernel.linkedCellNumMolecules = linkedCellNumMolecules;
+        return kernel;
+    }
+
+    PackOffsetsKernel packOffsetsKernel(const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>& offsets) const
+    {
+        PackOffsetsKernel kernel;
+        kernel.linkedCellNumMolecules = linkedCellNumMolecules;
+        kernel.offsets = offsets;
+        kernel.numCells = _numCells;
+        kernel.numCellsPerDim = _numCellsPerDim;
+        kernel.numCellsPerDimWithHalo = _numCellsPerDimWithHalo;
+        kernel.haloWidth = _haloWidth;
+        return kernel;
+    }
+
+    PackKernel packKernel(const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>& offsets, const Kokkos::View<double*[4], Kokkos::LayoutRight, Kokkos::SharedSpace>& buffer) const
+    {
+        PackKernel kernel;
+        kernel.moleculeData = moleculeData;
+        kernel.linkedCellNumMolecules = linkedCellNumMolecules;
+        kernel.quantised = quantisedPositions;
+        kernel.offsets = offsets;
+        kernel.buffer = buffer;
+        return kernel;
+    }
+
+    // moves every molecule of an interior cell to the cell its position belongs to, ghost cells are left untouched
+    // periodic containers first wrap positions back into the domain, call refreshHalo afterwards to update the ghost cells
+    // molecules may have moved at most cellsPerCutoff cells since the last sort, farther moves would let two cells of a colour write
+    // to each other, which debug builds assert, bin places molecules that moved arbitrarily far
+    void sort(const IndexConverter& indexConverter, const ExecutionSpace& space = ExecutionSpace())
+    {
+        for (int colour = 0; colour < numSortColours(); colour++)
+        {
+            const SortColourKernel kernel = sortColourKernel(indexConverter, colour);
+            Kokkos::parallel_for(CellPolicy(space, 0, kernel.length()), kernel);
+        }
+        space.fence();
+    }
+
+    // every cell is sorted as soon as the scheduler owns its neighbourhood instead of colour by colour,
+    // the scheduler has to come from CellTaskScheduler::forSort with this container's geometry
+    // cells then hold the same molecules as after sort only if no molecule moves further than the scheduler's reach,
+    // a farther move writes outside the task's lock set, which debug builds assert
+    void sort(const IndexConverter& indexConverter, const CellTaskScheduler& scheduler)
+    {
+        assert(scheduler.numTasks() == _numCellsPerDim * _numCellsPerDim * _numCellsPerDim);
+        struct LockedCells : Cells
+        {
+            int target(const int cell, const int slot, double pos[3]) const
+            {
+                const int index = Cells::target(cell, slot, pos);
+                assert(index == cell || scheduler->locks(cell, index));
+                return index;
+            }
+
+            const CellTaskScheduler* scheduler;
+        };
+        LockedCells cells;
+        static_cast<Cells&>(cells) = cellAccess(indexConverter);
+        cells.scheduler = &scheduler;
+        scheduler.run([&](const int index) { CellOperations::sortCell(cells, index); });
+    }
+
+    // moves every molecule of an interior cell to the cell its position belongs to however far it moved, e.g. after populateRandomly:
+    // counts the molecules of every target cell, grows the capacity to the fullest one and scatters the molecules into a fresh block,
+    // so no cell is read and written at the same time, ghost cells are left empty until refreshHalo
+    void bin(const IndexConverter& indexConverter)
+    {
+        assert(indexConverter.haloWidth == _haloWidth && indexConverter.numCellsPerDim == _numCellsPerDim);
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> counts("binCounts", _numCells);
+        const int numCellsPerDimWithHalo = _numCellsPerDimWithHalo;
+        const int haloWidth = _haloWidth;
+        const int last = _numCellsPerDim + _haloWidth;
+        int cellSize = _cellSize;
+        MoleculeView binned;
+        QuantisedPositions binnedQuantised;
+        {
+            const Cells cells = cellAccess(indexConverter);
+            Kokkos::parallel_for(CellPolicy(0, _numCells), KOKKOS_LAMBDA(const unsigned int i) {
+                const int x = i % numCellsPerDimWithHalo, y = (i / numCellsPerDimWithHalo) % numCellsPerDimWithHalo, z = i / (numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+                if(x < haloWidth || y < haloWidth || z < haloWidth || x >= last || y >= last || z >= last)
+                    return;
+                for (int j = 0; j < cells.count(i); j++)
+                {
+                    double pos[3];
+                    Kokkos::atomic_increment(&counts(cells.target(i, j, pos)));
+                }
+            });
+            int peak = 0;
+            Kokkos::parallel_reduce(CellPolicy(0, _numCells), KOKKOS_LAMBDA(const int i, int& localMax) {
+                if(counts(i) > localMax) localMax = counts(i);
+            }, Kokkos::Max<int>(peak));
+            cellSize = std::max(cellSize, peak);
+
+            binned = _moleculePool.acquire("moleculeData", _numCells, cellSize);
+            if(_hugePages) adviseHugePages(binned);
+            Cells binnedCells = cells;
+            binnedCells.moleculeData = binned;
+            binnedCells.linkedCellNumMolecules = counts;
+            binnedCells.quantised = quantisedPositions.enabled() ? quantisedPositions.resized(_numCells, cellSize) : QuantisedPositions();
+            // the fresh block is first touched with the static mapping of the CellPolicy kernels, then the counts serve as fill pointers
+            Kokkos::parallel_for(CellPolicy(0, _numCells), KOKKOS_LAMBDA(const unsigned int i) {
+                for (int j = 0; j < cellSize; j++)
+                    binned(i, j) = Molecule();
+                counts(i) = 0;
+            });
+            Kokkos::parallel_for(CellPolicy(0, _numCells), KOKKOS_LAMBDA(const unsigned int i) {
+                const int x = i % numCellsPerDimWithHalo, y = (i / numCellsPerDimWithHalo) % numCellsPerDimWithHalo, z = i / (numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+                if(x < haloWidth || y < haloWidth || z < haloWidth || x >= last || y >= last || z >= last)
+                    return;
+                for (int j = 0; j < cells.count(i); j++)
                 {
-                    const int lengthVector[3] = {(_numCellsPerDim + (_numCellsPerDim % 2) * (x == 0)) / 2, (_numCellsPerDim + (_numCellsPerDim % 2) * (y == 0)) / 2, (_numCellsPerDim + (_numCellsPerDim % 2) * (z == 0)) / 2};
-                    const int length = lengthVector[0] * lengthVector[1] * lengthVector[2];
-                    const int numCellsPerDim = _numCellsPerDim;
-                    auto linkedCellLocal(linkedCellNumMolecules);
-                    auto moleculeDataLocal(moleculeData);
-                    Kokkos::parallel_for(length, KOKKOS_LAMBDA(const unsigned int j) {
-                        // compute index of the current cell
-                        int index = 0;
-                        int helpIndex1 = j;
-                        int helpIndex2 = 0;
-                        // determine plane within traversed block
-                        helpIndex2 = helpIndex1 / (lengthVector[0] * lengthVector[1]);
-                        // save rest of index in helpIndex1
-                        helpIndex1 = helpIndex1 - helpIndex2 * (lengthVector[0] * lengthVector[1]);
-                        // compute contribution to index
-                        index += (0+ 2 * helpIndex2 + z) * numCellsPerDim * numCellsPerDim;
-                        // determine plane within traversed block
-                        helpIndex2 = helpIndex1 / lengthVector[0];
-                        // save rest of index in helpIndex1
-                        helpIndex1 = helpIndex1 - helpIndex2 * lengthVector[0];
-                        // compute contribution to index
-                        index += (0 + 2 * helpIndex2 + y) * numCellsPerDim;
-                        // compute contribution for last dimension
-                        index += (0 + 2 * helpIndex1 + x);
-
-                        for (size_t i = 0; i < linkedCellLocal(index); i++)
-                        {
-                            int curMolIdx = indexConverter.getIndex(moleculeDataLocal(index, i).pos);
-                            if(curMolIdx != index) // if molecule does not belong to current cell anymore
-                            {
-                                // write data to target end
-                                moleculeDataLocal(curMolIdx, linkedCellLocal(curMolIdx)) = moleculeDataLocal(index, i);
-                                // increment target end
-                                linkedCellLocal(curMolIdx)++;
-                                // delete molecule at own position
-                                moleculeDataLocal(index, i) = moleculeDataLocal(index, linkedCellLocal(index) - 1);
-                                linkedCellLocal(index) -= 1;
-                                // decrement iterator as the molecule at position i is now new
-                                i--;
-                            }
-                        }
-                    });
+                    double pos[3];
+                    const int target = cells.target(i, j, pos);
+                    const int slot = Kokkos::atomic_fetch_add(&counts(target), 1);
+                    binned(target, slot) = cells.at(i, j);
+                    binnedCells.placed(target, slot, pos);
                 }
+            });
+            Kokkos::fence();
+            binnedQuantised = binnedCells.quantised;
+        }
+        Kokkos::deep_copy(linkedCellNumMolecules, counts);
+        replaceData(binned, binnedQuantised, cellSize);
+    }
+
+    // removes holes (dirty molecules) from the occupied part of every cell by swap-with-last, does not keep order
+    void compact(const ExecutionSpace& space = ExecutionSpace())
+    {
+        compactCells(CompactionStrategy::onesweep_noOrder, cellAccess(IndexConverter()), space);
+    }
+
+    // removes holes with the kernel the selector picks for the current hole fraction and capacity, out of swap-with-last (onesweep_noOrder)
+    // and shifting forward (onesweep), with keepOrder only the latter
+    // a new context is calibrated first by timing every candidate on a copy of the molecules and counts, without codes and id index
+    CompactionDecision compact(CompactionSelector& selector, bool keepOrder, bool display = false, const ExecutionSpace& space = ExecutionSpace())
+    {
+        long holes = 0, molecules = 0;
+        countHoles(holes, molecules, space);
+        CompactionDecision decision;
+        decision.holeFraction = static_cast<double>(holes) / std::max(molecules, 1L);
+        decision.cellSize = _cellSize;
+        decision.keepOrder = keepOrder;
+        const double slots = std::max(molecules, 1L);
+        const int context = selector.context(decision.holeFraction, _cellSize, keepOrder);
+        std::vector<CompactionStrategy> candidates = {CompactionStrategy::onesweep};
+        if(!keepOrder) candidates.push_back(CompactionStrategy::onesweep_noOrder);
+        if(!selector.isCalibrated(context))
+        {
+            MoleculeView moleculeCopy = _compactionPool.acquire("compactionCopy", _numCells, _cellSize);
+            Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> countCopy(Kokkos::view_alloc(Kokkos::WithoutInitializing, "compactionCounts"), _numCells);
+            Cells copy;
+            copy.moleculeData = moleculeCopy;
+            copy.linkedCellNumMolecules = countCopy;
+            for (CompactionStrategy strategy : candidates)
+            {
+                Kokkos::deep_copy(moleculeCopy, moleculeData);
+                Kokkos::deep_copy(countCopy, linkedCellNumMolecules);
+                Kokkos::fence();
+                auto t1 = std::chrono::high_resolution_clock::now();
+                compactCells(strategy, copy, space);
+                auto t2 = std::chrono::high_resolution_clock::now();
+                const double time = std::chrono::duration<double, std::micro>(t2-t1).count();
+                selector.record(context, strategy, time / slots);
+                decision.calibrationTime += time;
             }
-            
+            _compactionPool.release(moleculeCopy);
+            decision.reason = "calibrated";
         }
-        Kokkos::fence();
+        bool explored = false;
+        decision.strategy = selector.choose(context, candidates, explored);
+        if(explored) decision.reason = "explored";
+        auto t1 = std::chrono::high_resolution_clock::now();
+        compactCells(decision.strategy, cellAccess(IndexConverter()), space);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        decision.time = std::chrono::duration<double, std::micro>(t2-t1).count();
+        selector.record(context, decision.strategy, decision.time / slots);
+        if(display) std::cout << "compact: " << decision.to_string() << std::endl;
+        return decision;
+    }
+
+    // refills every ghost cell with the molecules of the interior cell it mirrors, positions shifted by the domain size
+    // afterwards neighbour traversals of interior cells need neither bounds checks nor minimum-image wrapping
+    void refreshHalo(const IndexConverter& indexConverter, const ExecutionSpace& space = ExecutionSpace())
+    {
+        if(_haloWidth == 0)
+            return;
+        Kokkos::parallel_for(CellPolicy(space, 0, _numCells), refreshHaloKernel(indexConverter));
+        space.fence();
+    }
+
+    // adds the forces accumulated on ghost copies back onto the interior molecules they mirror
+    // needed after traversals that also write forces of neighbour molecules, ghost forces must have been cleared after the last refreshHalo
+    void foldHaloForces(const ExecutionSpace& space = ExecutionSpace())
+    {
+        if(_haloWidth == 0)
+            return;
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const int numCellsPerDim = _numCellsPerDim;
+        const int numCellsPerDimWithHalo = _numCellsPerDimWithHalo;
+        const int haloWidth = _haloWidth;
+        const int last = _numCellsPerDim + _haloWidth;
+        // every interior cell gathers from all of its images, so each kernel instance only writes its own cell
+        Kokkos::parallel_for(CellPolicy(space, 0, _numCells), KOKKOS_LAMBDA(const unsigned int i) {
+            const int coordinate[3] = {static_cast<int>(i) % numCellsPerDimWithHalo, (static_cast<int>(i) / numCellsPerDimWithHalo) % numCellsPerDimWithHalo, static_cast<int>(i) / (numCellsPerDimWithHalo * numCellsPerDimWithHalo)};
+            if(coordinate[0] < haloWidth || coordinate[1] < haloWidth || coordinate[2] < haloWidth || coordinate[0] >= last || coordinate[1] >= last || coordinate[2] >= last)
+                return;
+            for (int image = 0; image < 27; image++)
+            {
+                if(image == 13)
+                    continue;
+                const int shift[3] = {image % 3 - 1, (image / 3) % 3 - 1, image / 9 - 1};
+                int imageIndex = 0;
+                bool inside = true;
+                for (int d = 2; d >= 0; d--)
+                {
+                    const int imageCoordinate = coordinate[d] + shift[d] * numCellsPerDim;
+                    inside = inside && imageCoordinate >= 0 && imageCoordinate < numCellsPerDimWithHalo;
+                    imageIndex = imageIndex * numCellsPerDimWithHalo + imageCoordinate;
+                }
+                if(!inside)
+                    continue;
+                for (int j = 0; j < linkedCellLocal(i); j++)
+                {
+                    moleculeDataLocal(i, j).f[0] += moleculeDataLocal(imageIndex, j).f[0];
+                    moleculeDataLocal(i, j).f[1] += moleculeDataLocal(imageIndex, j).f[1];
+                    moleculeDataLocal(i, j).f[2] += moleculeDataLocal(imageIndex, j).f[2];
+                }
+            }
+        });
+        space.fence();
+    }
+
+    KOKKOS_FUNCTION bool isHaloCell(int cellIdx) const
+    {
+        const int x = cellIdx % _numCellsPerDimWithHalo, y = (cellIdx / _numCellsPerDimWithHalo) % _numCellsPerDimWithHalo, z = cellIdx / (_numCellsPerDimWithHalo * _numCellsPerDimWithHalo);
+        const int last = _numCellsPerDim + _haloWidth;
+        return x < _haloWidth || y < _haloWidth || z < _haloWidth || x >= last || y >= last || z >= last;
+    }
+
+    void clearForces(const ExecutionSpace& space = ExecutionSpace())
+    {
+        Kokkos::parallel_for(CellPolicy(space, 0, _numCells), clearForcesKernel());
+        space.fence();
+    }
+
+    // writes id and position of every interior molecule contiguously into buffer, cell by cell
+    // offsets needs getNumCells() + 1 entries, offsets(getNumCells()) holds the number of packed molecules once space is fenced
+    // only reads positions, so it may overlap with operations that only touch forces
+    void packPositions(const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>& offsets, const Kokkos::View<double*[4], Kokkos::LayoutRight, Kokkos::SharedSpace>& buffer,
+        const ExecutionSpace& space = ExecutionSpace()) const
+    {
+        Kokkos::parallel_scan(CellPolicy(space, 0, _numCells), packOffsetsKernel(offsets));
+        Kokkos::parallel_for(CellPolicy(space, 0, _numCells), packKernel(offsets, buffer));
+        space.fence();
     }
 
     void printData() const
@@ -126,10 +758,15 @@ public:
         //not in parallel to make sure the same rows have same data for some seed
         for (size_t i = 0; i < _numCells; i++)
         {
+            // ghost cells are only filled by refreshHalo
+            if(isHaloCell(i))
+                continue;
             for (size_t j = 0; j < _cellSize; j++)
             {
                 Molecule m((i*_cellSize + j), _dis(_gen) % domainSize, _dis(_gen) % domainSize, _dis(_gen) % domainSize, _dis(_gen) % domainSize, _dis(_gen) % domainSize,_dis(_gen) % domainSize, _dis(_gen) % domainSize, _dis(_gen) % domainSize, _dis(_gen) % domainSize);
                 moleculeData(i,j) = m;
+                moleculeLocations.set(m.id, i, j);
+                if(quantisedPositions.enabled()) quantisedPositions.encode(i, j, m.pos);
             }
             linkedCellNumMolecules(i)= _cellSize;
         }
@@ -144,7 +781,11 @@ public:
         for (size_t i = 0; i < numHoles; i++)
         {
             Molecule m;
-            moleculeData(allCoords[i]/_cellSize, allCoords[i]%_cellSize) = m;
+            const int cellIdx = allCoords[i]/_cellSize, slot = allCoords[i]%_cellSize;
+            const int oldId = moleculeData(cellIdx, slot).id;
+            if(moleculeLocations.cell(oldId) == cellIdx && moleculeLocations.slot(oldId) == slot)
+                moleculeLocations.clear(oldId);
+            moleculeData(cellIdx, slot) = m;
         }
     }
 
@@ -156,7 +797,7 @@ public:
         // Kokkos::View<int, Kokkos::LayoutRight, Kokkos::SharedSpace> lcSizeSlice(linkedCellNumMolecules, idx);
         // return LinkedCell(lcSizeSlice, lcMoleculeSlice);
 
-        LinkedCell* cell = new (&linkedCells(idx)) LinkedCell(&linkedCellNumMolecules, &moleculeData, idx);
+        LinkedCell* cell = new (&linkedCells(idx)) LinkedCell(&linkedCellNumMolecules, &moleculeData, idx, &moleculeLocations, &quantisedPositions);
         return *cell;
 
         // return LinkedCell(&linkedCellNumMolecules, &moleculeData, idx);
@@ -166,6 +807,15 @@ public:
     }
 
     KOKKOS_FUNCTION int getNumCells() const { return _numCells; }
+    KOKKOS_FUNCTION int getNumCellsPerDim() const { return _numCellsPerDim; }
+    KOKKOS_FUNCTION int getNumCellsPerDimWithHalo() const { return _numCellsPerDimWithHalo; }
+    KOKKOS_FUNCTION int getHaloWidth() const { return _haloWidth; }
+    KOKKOS_FUNCTION int getCellsPerCutoff() const { return _cellsPerCutoff; }
+    KOKKOS_FUNCTION int getNumInteriorCells() const { return _numCellsPerDim*_numCellsPerDim*_numCellsPerDim; }
+    KOKKOS_FUNCTION int getCellSize() const { return _cellSize; }
+    // changes whenever a View that kernels capture by value is replaced: every reallocation and every enabling or disabling of
+    // quantised positions or the id index, kernels and graphs built at an older generation work on stale memory
+    int getGeneration() const { return _generation; }
 
     
     void testTestData() {
@@ -182,15 +832,140 @@ public:
         });
     }
 
-    Kokkos::View<Molecule**, Kokkos::LayoutRight, Kokkos::SharedSpace> moleculeData;
+    MoleculeView moleculeData;
+    MoleculeLocationIndex moleculeLocations;
+    QuantisedPositions quantisedPositions;
     Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> linkedCellNumMolecules;
     Kokkos::View<LinkedCell*, Kokkos::LayoutRight, Kokkos::SharedSpace> linkedCells;
 
 
 private:
-    int _numCells;
+    // moves the occupied slots into a block of the new capacity taken from the pool
+    void reallocate(int cellSize)
+    {
+        MoleculeView reallocated = _moleculePool.acquire("moleculeData", _numCells, cellSize);
+        if(_hugePages) adviseHugePages(reallocated);
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const QuantisedPositions quantised = quantisedPositions;
+        const QuantisedPositions reallocatedQuantised = quantised.enabled() ? quantised.resized(_numCells, cellSize) : QuantisedPositions();
+        // writing every slot, not only the occupied ones, first-touches the whole row on the thread that owns the cell
+        Kokkos::parallel_for(CellPolicy(0, _numCells), KOKKOS_LAMBDA(const unsigned int i) {
+            for (int j = 0; j < cellSize; j++)
+            {
+                reallocated(i, j) = j < linkedCellLocal(i) ? moleculeDataLocal(i, j) : Molecule();
+                if(reallocatedQuantised.enabled() && j < linkedCellLocal(i)) reallocatedQuantised.copy(quantised, i, j);
+            }
+        });
+        Kokkos::fence();
+        moleculeDataLocal = MoleculeView();
+        replaceData(reallocated, reallocatedQuantised, cellSize);
+    }
+
+    // the old block only goes back to the pool when the capacity does not grow, a later reserve or bin may ask for it again,
+    // blocks smaller than a grown capacity are freed, pooled or not, since no growth requests them again
+    void replaceData(const MoleculeView& replacement, const QuantisedPositions& replacementQuantised, int cellSize)
+    {
+        quantisedPositions = replacementQuantised;
+        if(cellSize <= _cellSize)
+            _moleculePool.release(moleculeData);
+        else
+            _moleculePool.discardIf([cellSize](const MoleculeView& pooled) { return static_cast<int>(pooled.extent(1)) < cellSize; });
+        moleculeData = replacement;
+        _cellSize = cellSize;
+        _generation++;
+    }
+
+    // default-constructs every slot and zeroes the cell counts with the static mapping of the CellPolicy kernels over all cells
+    void firstTouch(const MoleculeView& view)
+    {
+        if(_hugePages) adviseHugePages(view);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const int cellSize = view.extent(1);
+        Kokkos::parallel_for(CellPolicy(0, _numCells), KOKKOS_LAMBDA(const unsigned int i) {
+            for (int j = 0; j < cellSize; j++)
+                view(i, j) = Molecule();
+            linkedCellLocal(i) = 0;
+        });
+        Kokkos::fence();
+    }
+
+    // transparent huge page hint for the page-aligned interior of a host allocation, a no-op elsewhere
+    static void adviseHugePages(const MoleculeView& view)
+    {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if(!std::is_same<ExecutionSpace::memory_space, Kokkos::HostSpace>::value)
+            return;
+        const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+        const uintptr_t begin = (reinterpret_cast<uintptr_t>(view.data()) + pageSize - 1) / pageSize * pageSize;
+        const uintptr_t end = (reinterpret_cast<uintptr_t>(view.data()) + view.size() * sizeof(Molecule)) / pageSize * pageSize;
+        if(end > begin)
+            madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE);
+#endif
+    }
+
+    // onesweep shifts molecules forward and keeps order, onesweep_noOrder swaps with the last, the only strategies of this container
+    void compactCells(CompactionStrategy strategy, const Cells& cells, const ExecutionSpace& space) const
+    {
+        assert(strategy == CompactionStrategy::onesweep || strategy == CompactionStrategy::onesweep_noOrder);
+        const bool keepOrder = strategy == CompactionStrategy::onesweep;
+        const int numCellsPerDimWithHalo = _numCellsPerDimWithHalo;
+        const int haloWidth = _haloWidth;
+        const int last = _numCellsPerDim + _haloWidth;
+        // ghost cells only hold copies that refreshHalo rebuilds, compacting them would overwrite tracked locations
+        Kokkos::parallel_for(CellPolicy(space, 0, _numCells), KOKKOS_LAMBDA(const unsigned int i) {
+            const int x = i % numCellsPerDimWithHalo, y = (i / numCellsPerDimWithHalo) % numCellsPerDimWithHalo, z = i / (numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+            if(x < haloWidth || y < haloWidth || z < haloWidth || x >= last || y >= last || z >= last)
+                return;
+            if(keepOrder)
+                CellOperations::compactCellKeepingOrder(cells, i);
+            else
+                CellOperations::compactCell(cells, i);
+        });
+        space.fence();
+    }
+
+    // dirty and all molecules of the interior cells
+    void countHoles(long& holes, long& molecules, const ExecutionSpace& space) const
+    {
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellNumMoleculesLocal(linkedCellNumMolecules);
+        const int numCellsPerDimWithHalo = _numCellsPerDimWithHalo;
+        const int haloWidth = _haloWidth;
+        const int last = _numCellsPerDim + _haloWidth;
+        Kokkos::parallel_reduce(CellPolicy(space, 0, _numCells), KOKKOS_LAMBDA(const int i, long& localHoles) {
+            const int x = i % numCellsPerDimWithHalo, y = (i / numCellsPerDimWithHalo) % numCellsPerDimWithHalo, z = i / (numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+            if(x < haloWidth || y < haloWidth || z < haloWidth || x >= last || y >= last || z >= last)
+                return;
+            for (int j = 0; j < linkedCellNumMoleculesLocal(i); j++)
+                localHoles += moleculeDataLocal(i, j).dirty;
+        }, holes);
+        Kokkos::parallel_reduce(CellPolicy(space, 0, _numCells), KOKKOS_LAMBDA(const int i, long& localMolecules) {
+            const int x = i % numCellsPerDimWithHalo, y = (i / numCellsPerDimWithHalo) % numCellsPerDimWithHalo, z = i / (numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+            if(x < haloWidth || y < haloWidth || z < haloWidth || x >= last || y >= last || z >= last)
+                return;
+            localMolecules += linkedCellNumMoleculesLocal(i);
+        }, molecules);
+    }
+
+    static int numCellsWithHalo(int numCellsPerDim, int haloWidth)
+    {
+        const int numCellsPerDimWithHalo = numCellsPerDim + 2 * haloWidth;
+        return numCellsPerDimWithHalo*numCellsPerDimWithHalo*numCellsPerDimWithHalo;
+    }
+
     int _numCellsPerDim;
+    int _haloWidth;
+    int _numCellsPerDimWithHalo;
+    int _cellsPerCutoff = 1;
+    int _numCells;
     int _cellSize;
+    int _generation = 0;
     std::mt19937 _gen;
     std::uniform_int_distribution<> _dis;
+    double _growthFactor = 1.5;
+    bool _hugePages = false;
+    ViewPool<MoleculeView> _moleculePool;
+    // copies the compaction kernels are calibrated on, kept apart from the reallocations of moleculeData
+    ViewPool<MoleculeView> _compactionPool;
 };
\ No newline at end of file
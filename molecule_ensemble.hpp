@@ -0,0 +1,291 @@
+#pragma once
+
+#include <iostream>
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+
+#include <Kokkos_Core.hpp>
+#include <Kokkos_Random.hpp>
+
+#include <molecule.hpp>
+#include <index_converter.hpp>
+#include <cell_operations.hpp>
+
+// numSystems independent linked-cell systems of the same grid shape in one set of Views with a leading system dimension
+// every operation covers all systems in one launch (sort in one launch per colour), so many small systems together keep a node busy that none of them fills alone
+// every system has its own domain size and is an open box without halo, molecule ids are per system
+class MoleculeEnsemble
+{
+public:
+    using ExecutionSpace = Kokkos::DefaultExecutionSpace;
+    using MoleculeView = Kokkos::View<Molecule***, Kokkos::LayoutRight, Kokkos::SharedSpace>;
+    using CountView = Kokkos::View<int**, Kokkos::LayoutRight, Kokkos::SharedSpace>;
+    using CellPolicy = Kokkos::RangePolicy<ExecutionSpace, Kokkos::Schedule<Kokkos::Static>>;
+    using TeamPolicy = Kokkos::TeamPolicy<ExecutionSpace>;
+    using RandomPool = Kokkos::Random_XorShift64_Pool<ExecutionSpace>;
+
+    MoleculeEnsemble(int numSystems, int numCellsPerDim, int cellSize, int domainSize, uint64_t seed = 1984) :
+        moleculeData("ensembleMoleculeData", numSystems, numCellsPerDim * numCellsPerDim * numCellsPerDim, cellSize),
+        linkedCellNumMolecules("ensembleLinkedCellNumMolecules", numSystems, numCellsPerDim * numCellsPerDim * numCellsPerDim),
+        domainSizes("ensembleDomainSizes", numSystems), _numSystems(numSystems), _numCellsPerDim(numCellsPerDim),
+        _numCells(numCellsPerDim * numCellsPerDim * numCellsPerDim), _cellSize(cellSize), _random(seed)
+    {
+        Kokkos::deep_copy(domainSizes, domainSize);
+    }
+
+    // grows the capacity of every cell of every system to at least cellSize
+    void reserve(int cellSize)
+    {
+        if(cellSize <= _cellSize)
+            return;
+        MoleculeView reallocated(Kokkos::view_alloc(Kokkos::WithoutInitializing, "ensembleMoleculeData"), _numSystems, _numCells, cellSize);
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const int numCells = _numCells;
+        Kokkos::parallel_for(CellPolicy(0, _numSystems * _numCells), KOKKOS_LAMBDA(const int k) {
+            const int s = k / numCells, i = k % numCells;
+            for (int j = 0; j < cellSize; j++)
+                reallocated(s, i, j) = j < linkedCellLocal(s, i) ? moleculeDataLocal(s, i, j) : Molecule();
+        });
+        Kokkos::fence();
+        moleculeData = reallocated;
+        _cellSize = cellSize;
+    }
+
+    // fills every cell of every system with moleculesPerCell molecules at uniformly random positions within the cell and its neighbours,
+    // so molecules are not yet in their cells but at most one cell away, as sort requires
+    void populateRandomly(int moleculesPerCell)
+    {
+        assert(moleculesPerCell <= _cellSize);
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        auto domainSizesLocal(domainSizes);
+        const RandomPool random = _random;
+        const int numCells = _numCells;
+        const int numCellsPerDim = _numCellsPerDim;
+        Kokkos::parallel_for(CellPolicy(0, _numSystems * _numCells), KOKKOS_LAMBDA(const int k) {
+            const int s = k / numCells, i = k % numCells;
+            const IndexConverter indexConverter(domainSizesLocal(s), numCellsPerDim);
+            const double cellWidth = indexConverter.cellWidth();
+            const int coordinate[3] = {i % numCellsPerDim, (i / numCellsPerDim) % numCellsPerDim, i / (numCellsPerDim * numCellsPerDim)};
+            RandomPool::generator_type generator = random.get_state();
+            for (int j = 0; j < moleculesPerCell; j++)
+            {
+                Molecule& m = moleculeDataLocal(s, i, j);
+                m.id = i * moleculesPerCell + j;
+                m.dirty = false;
+                for (int d = 0; d < 3; d++)
+                {
+                    const double low = Kokkos::fmax(0.0, (coordinate[d] - 1) * cellWidth);
+                    const double high = Kokkos::fmin(static_cast<double>(domainSizesLocal(s)), (coordinate[d] + 2) * cellWidth);
+                    m.pos[d] = generator.drand(low, high);
+                    m.vel[d] = generator.drand(-1.0, 1.0);
+                    m.f[d] = 0;
+                }
+            }
+            random.free_state(generator);
+            linkedCellLocal(s, i) = moleculesPerCell;
+        });
+        Kokkos::fence();
+    }
+
+    // marks every occupied slot as a hole with probability holeFraction
+    void makeRandomHoles(double holeFraction)
+    {
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const RandomPool random = _random;
+        const int numCells = _numCells;
+        Kokkos::parallel_for(CellPolicy(0, _numSystems * _numCells), KOKKOS_LAMBDA(const int k) {
+            const int s = k / numCells, i = k % numCells;
+            RandomPool::generator_type generator = random.get_state();
+            for (int j = 0; j < linkedCellLocal(s, i); j++)
+                if(generator.drand() < holeFraction)
+                    moleculeDataLocal(s, i, j).dirty = true;
+            random.free_state(generator);
+        });
+        Kokkos::fence();
+    }
+
+    // largest number of molecules a cell holds during sort, its own plus the incoming ones, over all systems
+    int projectPeakOccupancy() const
+    {
+        CountView incoming("ensembleIncoming", _numSystems, _numCells);
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        auto domainSizesLocal(domainSizes);
+        const int numCells = _numCells;
+        const int numCellsPerDim = _numCellsPerDim;
+        Kokkos::parallel_for(CellPolicy(0, _numSystems * _numCells), KOKKOS_LAMBDA(const int k) {
+            const int s = k / numCells, i = k % numCells;
+            const IndexConverter indexConverter(domainSizesLocal(s), numCellsPerDim);
+            for (int j = 0; j < linkedCellLocal(s, i); j++)
+            {
+                const int target = indexConverter.getIndex(moleculeDataLocal(s, i, j).pos);
+                if(target != i)
+                    Kokkos::atomic_increment(&incoming(s, target));
+            }
+        });
+        int peak = 0;
+        Kokkos::parallel_reduce(CellPolicy(0, _numSystems * _numCells), KOKKOS_LAMBDA(const int k, int& localMax) {
+            const int s = k / numCells, i = k % numCells;
+            if(linkedCellLocal(s, i) + incoming(s, i) > localMax) localMax = linkedCellLocal(s, i) + incoming(s, i);
+        }, Kokkos::Max<int>(peak));
+        return peak;
+    }
+
+    // the cells of one system for the shared bodies of CellOperations, the ensemble keeps no side data
+    struct SystemCells
+    {
+        KOKKOS_INLINE_FUNCTION int& count(const int cell) const { return linkedCellNumMolecules(system, cell); }
+        KOKKOS_INLINE_FUNCTION Molecule& at(const int cell, const int slot) const { return moleculeData(system, cell, slot); }
+        KOKKOS_INLINE_FUNCTION int target(const int cell, const int slot, double pos[3]) const
+        {
+            for (int d = 0; d < 3; d++)
+                pos[d] = moleculeData(system, cell, slot).pos[d];
+            const int index = indexConverter.getIndex(pos);
+            // a farther move could land in a cell of the same colour while it is sorted
+            assert(withinOneCell(cell, index));
+            return index;
+        }
+        KOKKOS_INLINE_FUNCTION bool withinOneCell(const int cell, const int target) const
+        {
+            const int n = indexConverter.numCellsPerDim;
+            for (int a = cell, b = target, d = 0; d < 3; d++, a /= n, b /= n)
+                if(a % n - b % n > 1 || b % n - a % n > 1)
+                    return false;
+            return true;
+        }
+        KOKKOS_INLINE_FUNCTION void placed(const int, const int, const double*) const {}
+        KOKKOS_INLINE_FUNCTION void copied(const int, const int, const int) const {}
+        KOKKOS_INLINE_FUNCTION void relocated(const int, const int) const {}
+
+        MoleculeView moleculeData;
+        CountView linkedCellNumMolecules;
+        IndexConverter indexConverter;
+        int system;
+    };
+
+    // moves every molecule of every system into its cell, the 8-colour scheme of MoleculeContainer::sort with all systems in each colour's launch,
+    // two cells of a colour that move molecules into the cell between them append atomically, molecules may be at most one cell away from their cell
+    void sort(const ExecutionSpace& space = ExecutionSpace())
+    {
+        for (int z = 0; z < 2; z++)
+        {
+            for (int y = 0; y < 2; y++)
+            {
+                for (int x = 0; x < 2; x++)
+                {
+                    const int lengthVector[3] = {(_numCellsPerDim + 1 - x) / 2, (_numCellsPerDim + 1 - y) / 2, (_numCellsPerDim + 1 - z) / 2};
+                    const int length = lengthVector[0] * lengthVector[1] * lengthVector[2];
+                    const int numCellsPerDim = _numCellsPerDim;
+                    auto moleculeDataLocal(moleculeData);
+                    auto linkedCellLocal(linkedCellNumMolecules);
+                    auto domainSizesLocal(domainSizes);
+                    Kokkos::parallel_for(CellPolicy(space, 0, _numSystems * length), KOKKOS_LAMBDA(const int k) {
+                        const int s = k / length, j = k % length;
+                        const int index = (2 * (j % lengthVector[0]) + x) + (2 * ((j / lengthVector[0]) % lengthVector[1]) + y) * numCellsPerDim
+                            + (2 * (j / (lengthVector[0] * lengthVector[1])) + z) * numCellsPerDim * numCellsPerDim;
+                        SystemCells cells;
+                        cells.moleculeData = moleculeDataLocal;
+                        cells.linkedCellNumMolecules = linkedCellLocal;
+                        cells.indexConverter = IndexConverter(domainSizesLocal(s), numCellsPerDim);
+                        cells.system = s;
+                        CellOperations::sortCell(cells, index);
+                    });
+                }
+            }
+        }
+        space.fence();
+    }
+
+    // removes holes (dirty molecules) from every cell of every system by swap-with-last, does not keep order
+    void compact(const ExecutionSpace& space = ExecutionSpace())
+    {
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const int numCells = _numCells;
+        Kokkos::parallel_for(CellPolicy(space, 0, _numSystems * _numCells), KOKKOS_LAMBDA(const int k) {
+            const int s = k / numCells, i = k % numCells;
+            SystemCells cells;
+            cells.moleculeData = moleculeDataLocal;
+            cells.linkedCellNumMolecules = linkedCellLocal;
+            cells.system = s;
+            CellOperations::compactCell(cells, i);
+        });
+        space.fence();
+    }
+
+    // per-system reductions, one team per system, results are written to the numSystems entries of the given View
+    void countMolecules(const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>& counts, const ExecutionSpace& space = ExecutionSpace()) const
+    {
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const int numCells = _numCells;
+        Kokkos::parallel_for("MoleculeEnsemble::countMolecules", TeamPolicy(space, _numSystems, Kokkos::AUTO), KOKKOS_LAMBDA(const TeamPolicy::member_type& team) {
+            const int s = team.league_rank();
+            int count = 0;
+            Kokkos::parallel_reduce(Kokkos::TeamThreadRange(team, numCells), [&](const int i, int& localCount) {
+                localCount += linkedCellLocal(s, i);
+            }, count);
+            Kokkos::single(Kokkos::PerTeam(team), [&]() { counts(s) = count; });
+        });
+        space.fence();
+    }
+
+    void maxOccupancy(const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>& occupancy, const ExecutionSpace& space = ExecutionSpace()) const
+    {
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const int numCells = _numCells;
+        Kokkos::parallel_for("MoleculeEnsemble::maxOccupancy", TeamPolicy(space, _numSystems, Kokkos::AUTO), KOKKOS_LAMBDA(const TeamPolicy::member_type& team) {
+            const int s = team.league_rank();
+            int maximum = 0;
+            Kokkos::parallel_reduce(Kokkos::TeamThreadRange(team, numCells), [&](const int i, int& localMax) {
+                if(linkedCellLocal(s, i) > localMax) localMax = linkedCellLocal(s, i);
+            }, Kokkos::Max<int>(maximum));
+            Kokkos::single(Kokkos::PerTeam(team), [&]() { occupancy(s) = maximum; });
+        });
+        space.fence();
+    }
+
+    // sum of v^2 / 2 over the molecules of each system, unit mass
+    void kineticEnergy(const Kokkos::View<double*, Kokkos::LayoutRight, Kokkos::SharedSpace>& energies, const ExecutionSpace& space = ExecutionSpace()) const
+    {
+        auto moleculeDataLocal(moleculeData);
+        auto linkedCellLocal(linkedCellNumMolecules);
+        const int numCells = _numCells;
+        Kokkos::parallel_for("MoleculeEnsemble::kineticEnergy", TeamPolicy(space, _numSystems, Kokkos::AUTO), KOKKOS_LAMBDA(const TeamPolicy::member_type& team) {
+            const int s = team.league_rank();
+            double energy = 0;
+            Kokkos::parallel_reduce(Kokkos::TeamThreadRange(team, numCells), [&](const int i, double& localEnergy) {
+                for (int j = 0; j < linkedCellLocal(s, i); j++)
+                {
+                    const Molecule& m = moleculeDataLocal(s, i, j);
+                    localEnergy += 0.5 * (m.vel[0] * m.vel[0] + m.vel[1] * m.vel[1] + m.vel[2] * m.vel[2]);
+                }
+            }, energy);
+            Kokkos::single(Kokkos::PerTeam(team), [&]() { energies(s) = energy; });
+        });
+        space.fence();
+    }
+
+    IndexConverter getIndexConverter(int system) const { return IndexConverter(domainSizes(system), _numCellsPerDim); }
+
+    KOKKOS_INLINE_FUNCTION Molecule& getMoleculeAt(int system, int cellIdx, int slot) const { return moleculeData(system, cellIdx, slot); }
+    KOKKOS_FUNCTION int getNumSystems() const { return _numSystems; }
+    KOKKOS_FUNCTION int getNumCells() const { return _numCells; }
+    KOKKOS_FUNCTION int getNumCellsPerDim() const { return _numCellsPerDim; }
+    KOKKOS_FUNCTION int getCellSize() const { return _cellSize; }
+
+    MoleculeView moleculeData;
+    CountView linkedCellNumMolecules;
+    // domain size of every system, may be changed before populateRandomly to sweep densities
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> domainSizes;
+
+private:
+    int _numSystems;
+    int _numCellsPerDim;
+    int _numCells;
+    int _cellSize;
+    RandomPool _random;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+// optional map from molecule id to its (cell, slot) in the container, (-1, -1) for ids that are not stored
+// ids outside [0, size) are not tracked, a default constructed index tracks nothing
+// kernels that move molecules capture it by value and update it next to every move
+struct MoleculeLocationIndex
+{
+    KOKKOS_INLINE_FUNCTION bool tracks(int id) const
+    {
+        return id >= 0 && id < static_cast<int>(locations.extent(0));
+    }
+    KOKKOS_INLINE_FUNCTION void set(int id, int cellIdx, int slot) const
+    {
+        if(!tracks(id))
+            return;
+        locations(id, 0) = cellIdx;
+        locations(id, 1) = slot;
+    }
+    KOKKOS_INLINE_FUNCTION void clear(int id) const
+    {
+        set(id, -1, -1);
+    }
+    KOKKOS_INLINE_FUNCTION int cell(int id) const { return tracks(id) ? locations(id, 0) : -1; }
+    KOKKOS_INLINE_FUNCTION int slot(int id) const { return tracks(id) ? locations(id, 1) : -1; }
+
+    Kokkos::View<int*[2], Kokkos::LayoutRight, Kokkos::SharedSpace> locations;
+};
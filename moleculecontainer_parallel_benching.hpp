@@ -4,9 +4,16 @@
 #include <vector>
 #include <algorithm>
 #include <numeric>
+#include <string>
+#include <cassert>
+#include <map>
+#include <sstream>
 
 #include <Kokkos_Core.hpp>
 
+#include <view_pool.hpp>
+#include <compaction_selector.hpp>
+
 class MoleculeContainer
 {
 public:
@@ -59,176 +66,476 @@ public:
         if(display) std::cout << numHoles << " holes created!" << std::endl;
     }
 
-    long compactor_onesweep(bool display = false)
+    // compaction kernels, each one removes the holes (zeros) of every row of data in place
+    static void compact_onesweep(const Kokkos::View<int**>& data)
     {
-        Kokkos::View<int**> containerCopy("copy", _numCells, _cellSize);
-        Kokkos::deep_copy(containerCopy, moleculeData);
-        auto t1 = std::chrono::high_resolution_clock::now();
-        Kokkos::parallel_for(_numCells, KOKKOS_LAMBDA(const unsigned int i)
+        const int cellSize = data.extent(1);
+        Kokkos::parallel_for(data.extent(0), KOKKOS_LAMBDA(const unsigned int i)
         {
             int j = 0;
             int lastHole = -1;
             //find first hole
-            for (; j < _cellSize; j++)
+            for (; j < cellSize; j++)
             {
-                if(containerCopy(i,j) == 0)
+                if(data(i,j) == 0)
                     break;
             }
             lastHole = j;
             //iterate first hole onwards
-            for (int j = lastHole; j < _cellSize; j++)
+            for (int j = lastHole; j < cellSize; j++)
             {
-                if(containerCopy(i,j) != 0)
+                if(data(i,j) != 0)
                 {
-                    containerCopy(i, lastHole) = containerCopy(i,j);
-                    containerCopy(i,j) = 0;
-                    while (containerCopy(i,lastHole) != 0 && lastHole < j) lastHole++;
+                    data(i, lastHole) = data(i,j);
+                    data(i,j) = 0;
+                    while (data(i,lastHole) != 0 && lastHole < j) lastHole++;
                 }
             }
         }); //kokkos parallel for
-        auto t2 = std::chrono::high_resolution_clock::now();
-        if(display)
-        {
-            std::cout << "Data compacted with onesweep! Data:" << std::endl;
-            for (size_t i = 0; i < _numCells; i++)
-            {
-                std::cout << "Cell #" << i << ": " ;
-                for (size_t j = 0; j < _cellSize; j++)
-                {
-                    std::cout << containerCopy(i,j) << " ";
-                }
-                std::cout << std::endl;
-            }
-        }
-        return std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count();
     }
 
-    long compactor_twosweep(bool display = false)
+    // shiftAmt holds one row of scratch per cell, at least as large as data
+    static void compact_twosweep(const Kokkos::View<int**>& data, const Kokkos::View<int**>& shiftAmt)
     {
-        Kokkos::View<int**> containerCopy("copy", _numCells, _cellSize);
-        Kokkos::deep_copy(containerCopy, moleculeData);
-        auto t1 = std::chrono::high_resolution_clock::now();
-        Kokkos::parallel_for(_numCells, KOKKOS_LAMBDA(const unsigned int i)
+        const int cellSize = data.extent(1);
+        assert(shiftAmt.extent(0) >= data.extent(0) && shiftAmt.extent(1) >= data.extent(1));
+        Kokkos::parallel_for(data.extent(0), KOKKOS_LAMBDA(const unsigned int i)
         {
-            int shiftAmt[_cellSize];
             int curShift = 0;
-            for (int j = 0; j < _cellSize; j++)
+            for (int j = 0; j < cellSize; j++)
             {
-                shiftAmt[j] = curShift;
-                if(containerCopy(i,j) == 0)
+                shiftAmt(i,j) = curShift;
+                if(data(i,j) == 0)
                 {
                     curShift++;
                 }
             }
-            for (int j = 0; j < _cellSize; j++)
+            for (int j = 0; j < cellSize; j++)
             {
-                if(containerCopy(i,j) != 0 && shiftAmt[j] != 0)
+                if(data(i,j) != 0 && shiftAmt(i,j) != 0)
                 {
-                    containerCopy(i, j-shiftAmt[j]) = containerCopy(i,j);
-                    containerCopy(i,j) = 0;
+                    data(i, j-shiftAmt(i,j)) = data(i,j);
+                    data(i,j) = 0;
                 }
             }
         }); //kokkos parallel for
-        auto t2 = std::chrono::high_resolution_clock::now();
-        if(display)
-        {
-            std::cout << "Data compacted with twosweep! Data:" << std::endl;
-            for (size_t i = 0; i < _numCells; i++)
-            {
-                std::cout << "Cell #" << i << ": " ;
-                for (size_t j = 0; j < _cellSize; j++)
-                {
-                    std::cout << containerCopy(i,j) << " ";
-                }
-                std::cout << std::endl;
-            }
-        }
-        return std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count();
     }
 
-    long compactor_pullback(bool display = false)
+    // sourceIdx holds one row of scratch per cell, at least as large as data
+    static void compact_pullback(const Kokkos::View<int**>& data, const Kokkos::View<int**>& sourceIdx)
     {
-        Kokkos::View<int**> containerCopy("copy", _numCells, _cellSize);
-        Kokkos::deep_copy(containerCopy, moleculeData);
-        auto t1 = std::chrono::high_resolution_clock::now();
-        Kokkos::parallel_for(_numCells, KOKKOS_LAMBDA(const unsigned int i)
+        const int cellSize = data.extent(1);
+        assert(sourceIdx.extent(0) >= data.extent(0) && sourceIdx.extent(1) >= data.extent(1));
+        Kokkos::parallel_for(data.extent(0), KOKKOS_LAMBDA(const unsigned int i)
         {
-            int sourceIdx[_cellSize];
             int sourceIdxIdx = 0;
-            for (int j = 0; j < _cellSize; j++)
+            for (int j = 0; j < cellSize; j++)
             {
-                if(containerCopy(i,j) != 0)
+                if(data(i,j) != 0)
                 {
-                    sourceIdx[sourceIdxIdx++] = j;
+                    sourceIdx(i,sourceIdxIdx++) = j;
                 }
             }
-            for (int j = 0; j < _cellSize; j++)
+            for (int j = 0; j < cellSize; j++)
             {
                 if(j < sourceIdxIdx)
-                    containerCopy(i, j) = containerCopy(i,sourceIdx[j]);
+                    data(i, j) = data(i,sourceIdx(i,j));
                 else
-                    containerCopy(i, j) = 0;
+                    data(i, j) = 0;
             }
         }); //kokkos parallel for
-        auto t2 = std::chrono::high_resolution_clock::now();
-        if(display)
+    }
+
+    // does not keep the order of the remaining entries
+    static void compact_onesweep_noOrder(const Kokkos::View<int**>& data)
+    {
+        const int cellSize = data.extent(1);
+        //Kokkos::RangePolicy<Kokkos::Schedule<Kokkos::Static>> rp(0, _numCells, Kokkos::ChunkSize(_cellSize));
+        Kokkos::parallel_for(data.extent(0), KOKKOS_LAMBDA(const unsigned int i)
+        {
+            int j = 0, k = cellSize - 1;
+            while(j < k)
+            {
+                //find first hole on left side
+                while(j < cellSize && data(i,j) != 0) j++;
+                //find first data on right side
+                while(k > -1 && data(i,k) == 0) k--;
+                if(k <= j) break;
+                data(i,j) = data(i,k);
+                data(i,k) = 0;
+            }
+        }); //kokkos parallel for
+    }
+
+    // variants specialised on a compile-time capacity, each row is staged in a fixed register array so per-cell loops fully unroll
+    // slots from the row length up to Capacity are treated as holes and never written back
+    template<int Capacity>
+    static void compact_onesweep_fixed(const Kokkos::View<int**>& data)
+    {
+        const int cellSize = data.extent(1);
+        assert(cellSize <= Capacity);
+        Kokkos::parallel_for(data.extent(0), KOKKOS_LAMBDA(const unsigned int i)
         {
-            std::cout << "Data compacted with pullback! Data:" << std::endl;
-            for (size_t i = 0; i < _numCells; i++)
+            int row[Capacity];
+            for (int j = 0; j < Capacity; j++)
+                row[j] = j < cellSize ? data(i,j) : 0;
+            int lastHole = Capacity;
+            for (int j = Capacity - 1; j >= 0; j--)
+            {
+                if(row[j] == 0) lastHole = j;
+            }
+            for (int j = 0; j < Capacity; j++)
             {
-                std::cout << "Cell #" << i << ": " ;
-                for (size_t j = 0; j < _cellSize; j++)
+                if(j > lastHole && row[j] != 0)
                 {
-                    std::cout << containerCopy(i,j) << " ";
+                    row[lastHole] = row[j];
+                    row[j] = 0;
+                    lastHole++;
                 }
-                std::cout << std::endl;
             }
-        }
-        return std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count();
+            for (int j = 0; j < Capacity; j++)
+            {
+                if(j < cellSize) data(i,j) = row[j];
+            }
+        }); //kokkos parallel for
     }
 
-    long compactor_onesweep_noOrder(bool display = false)
+    template<int Capacity>
+    static void compact_twosweep_fixed(const Kokkos::View<int**>& data)
     {
-        Kokkos::View<int**> containerCopy("copy", _numCells, _cellSize);
-        Kokkos::deep_copy(containerCopy, moleculeData);
-        auto t1 = std::chrono::high_resolution_clock::now();
-        //Kokkos::RangePolicy<Kokkos::Schedule<Kokkos::Static>> rp(0, _numCells, Kokkos::ChunkSize(_cellSize));
-        Kokkos::parallel_for(_numCells, KOKKOS_LAMBDA(const unsigned int i)
+        const int cellSize = data.extent(1);
+        assert(cellSize <= Capacity);
+        Kokkos::parallel_for(data.extent(0), KOKKOS_LAMBDA(const unsigned int i)
+        {
+            int row[Capacity];
+            int shiftAmt[Capacity];
+            int compacted[Capacity];
+            int curShift = 0;
+            for (int j = 0; j < Capacity; j++)
+            {
+                row[j] = j < cellSize ? data(i,j) : 0;
+                compacted[j] = 0;
+                shiftAmt[j] = curShift;
+                curShift += (row[j] == 0);
+            }
+            for (int j = 0; j < Capacity; j++)
+            {
+                if(row[j] != 0)
+                    compacted[j-shiftAmt[j]] = row[j];
+            }
+            for (int j = 0; j < Capacity; j++)
+            {
+                if(j < cellSize) data(i,j) = compacted[j];
+            }
+        }); //kokkos parallel for
+    }
+
+    template<int Capacity>
+    static void compact_pullback_fixed(const Kokkos::View<int**>& data)
+    {
+        const int cellSize = data.extent(1);
+        assert(cellSize <= Capacity);
+        Kokkos::parallel_for(data.extent(0), KOKKOS_LAMBDA(const unsigned int i)
         {
-            int j = 0, k = _cellSize - 1;
+            int row[Capacity];
+            int sourceIdx[Capacity];
+            int sourceIdxIdx = 0;
+            for (int j = 0; j < Capacity; j++)
+            {
+                row[j] = j < cellSize ? data(i,j) : 0;
+                sourceIdx[sourceIdxIdx] = j;
+                sourceIdxIdx += (row[j] != 0);
+            }
+            for (int j = 0; j < Capacity; j++)
+            {
+                if(j < cellSize) data(i,j) = j < sourceIdxIdx ? row[sourceIdx[j]] : 0;
+            }
+        }); //kokkos parallel for
+    }
+
+    template<int Capacity>
+    static void compact_onesweep_noOrder_fixed(const Kokkos::View<int**>& data)
+    {
+        const int cellSize = data.extent(1);
+        assert(cellSize <= Capacity);
+        Kokkos::parallel_for(data.extent(0), KOKKOS_LAMBDA(const unsigned int i)
+        {
+            int row[Capacity];
+            for (int j = 0; j < Capacity; j++)
+                row[j] = j < cellSize ? data(i,j) : 0;
+            int j = 0, k = Capacity - 1;
             while(j < k)
             {
                 //find first hole on left side
-                while(j < _cellSize && containerCopy(i,j) != 0) j++;
+                while(j < Capacity && row[j] != 0) j++;
                 //find first data on right side
-                while(k > -1 && containerCopy(i,k) == 0) k--;
+                while(k > -1 && row[k] == 0) k--;
                 if(k <= j) break;
-                containerCopy(i,j) = containerCopy(i,k);
-                containerCopy(i,k) = 0;
+                row[j] = row[k];
+                row[k] = 0;
+            }
+            for (int j = 0; j < Capacity; j++)
+            {
+                if(j < cellSize) data(i,j) = row[j];
             }
         }); //kokkos parallel for
+    }
+
+    // pick the smallest specialised capacity that fits, generic kernels otherwise
+    static void compact_onesweep_specialised(const Kokkos::View<int**>& data)
+    {
+        const int cellSize = data.extent(1);
+        if(cellSize <= 8) compact_onesweep_fixed<8>(data);
+        else if(cellSize <= 16) compact_onesweep_fixed<16>(data);
+        else if(cellSize <= 32) compact_onesweep_fixed<32>(data);
+        else if(cellSize <= 64) compact_onesweep_fixed<64>(data);
+        else compact_onesweep(data);
+    }
+
+    static void compact_twosweep_specialised(const Kokkos::View<int**>& data, const Kokkos::View<int**>& scratch)
+    {
+        const int cellSize = data.extent(1);
+        if(cellSize <= 8) compact_twosweep_fixed<8>(data);
+        else if(cellSize <= 16) compact_twosweep_fixed<16>(data);
+        else if(cellSize <= 32) compact_twosweep_fixed<32>(data);
+        else if(cellSize <= 64) compact_twosweep_fixed<64>(data);
+        else compact_twosweep(data, scratch);
+    }
+
+    static void compact_pullback_specialised(const Kokkos::View<int**>& data, const Kokkos::View<int**>& scratch)
+    {
+        const int cellSize = data.extent(1);
+        if(cellSize <= 8) compact_pullback_fixed<8>(data);
+        else if(cellSize <= 16) compact_pullback_fixed<16>(data);
+        else if(cellSize <= 32) compact_pullback_fixed<32>(data);
+        else if(cellSize <= 64) compact_pullback_fixed<64>(data);
+        else compact_pullback(data, scratch);
+    }
+
+    static void compact_onesweep_noOrder_specialised(const Kokkos::View<int**>& data)
+    {
+        const int cellSize = data.extent(1);
+        if(cellSize <= 8) compact_onesweep_noOrder_fixed<8>(data);
+        else if(cellSize <= 16) compact_onesweep_noOrder_fixed<16>(data);
+        else if(cellSize <= 32) compact_onesweep_noOrder_fixed<32>(data);
+        else if(cellSize <= 64) compact_onesweep_noOrder_fixed<64>(data);
+        else compact_onesweep_noOrder(data);
+    }
+
+    // scratch is only used by the generic twosweep and pullback kernels, one row per cell at least as large as data
+    static void launchCompactor(CompactionStrategy strategy, const Kokkos::View<int**>& data, const Kokkos::View<int**>& scratch)
+    {
+        switch (strategy)
+        {
+            case CompactionStrategy::onesweep: compact_onesweep(data); break;
+            case CompactionStrategy::twosweep: compact_twosweep(data, scratch); break;
+            case CompactionStrategy::pullback: compact_pullback(data, scratch); break;
+            case CompactionStrategy::onesweep_noOrder: compact_onesweep_noOrder(data); break;
+            case CompactionStrategy::onesweep_specialised: compact_onesweep_specialised(data); break;
+            case CompactionStrategy::twosweep_specialised: compact_twosweep_specialised(data, scratch); break;
+            case CompactionStrategy::pullback_specialised: compact_pullback_specialised(data, scratch); break;
+            case CompactionStrategy::onesweep_noOrder_specialised: compact_onesweep_noOrder_specialised(data); break;
+        }
+    }
+
+    // benchmarks, each one compacts a scratch copy of the container and returns the kernel time in microseconds
+    long compactor_onesweep(bool display = false) { return timeOnCopy(CompactionStrategy::onesweep, display); }
+    long compactor_twosweep(bool display = false) { return timeOnCopy(CompactionStrategy::twosweep, display); }
+    long compactor_pullback(bool display = false) { return timeOnCopy(CompactionStrategy::pullback, display); }
+    long compactor_onesweep_noOrder(bool display = false) { return timeOnCopy(CompactionStrategy::onesweep_noOrder, display); }
+    long compactor_onesweep_specialised(bool display = false) { return timeOnCopy(CompactionStrategy::onesweep_specialised, display); }
+    long compactor_twosweep_specialised(bool display = false) { return timeOnCopy(CompactionStrategy::twosweep_specialised, display); }
+    long compactor_pullback_specialised(bool display = false) { return timeOnCopy(CompactionStrategy::pullback_specialised, display); }
+    long compactor_onesweep_noOrder_specialised(bool display = false) { return timeOnCopy(CompactionStrategy::onesweep_noOrder_specialised, display); }
+
+    // compacts the container itself with the kernel the selector picks for its current hole fraction and capacity,
+    // a new context is calibrated first by timing every candidate on a scratch copy
+    CompactionDecision compact(CompactionSelector& selector, bool keepOrder, bool display = false)
+    {
+        CompactionDecision decision;
+        decision.holeFraction = static_cast<double>(countHoles()) / (static_cast<double>(_numCells) * _cellSize);
+        decision.cellSize = _cellSize;
+        decision.keepOrder = keepOrder;
+        const double slots = static_cast<double>(_numCells) * _cellSize;
+        const int context = selector.context(decision.holeFraction, _cellSize, keepOrder);
+        const std::vector<CompactionStrategy> candidates = CompactionSelector::candidates(_cellSize, keepOrder);
+        Kokkos::View<int**> indices = _scratchPool.acquire("indices", _numCells, _cellSize);
+        if(!selector.isCalibrated(context))
+        {
+            Kokkos::View<int**> containerCopy = _scratchPool.acquire("copy", _numCells, _cellSize);
+#ifndef NDEBUG
+            Kokkos::View<int**> referenceCopy = _scratchPool.acquire("copy", _numCells, _cellSize);
+            Kokkos::deep_copy(referenceCopy, moleculeData);
+            launchCompactor(CompactionStrategy::pullback, referenceCopy, indices);
+#endif
+            for (CompactionStrategy strategy : candidates)
+            {
+                Kokkos::deep_copy(containerCopy, moleculeData);
+                Kokkos::fence();
+                auto t1 = std::chrono::high_resolution_clock::now();
+                launchCompactor(strategy, containerCopy, indices);
+                Kokkos::fence();
+                auto t2 = std::chrono::high_resolution_clock::now();
+                const double time = std::chrono::duration<double, std::micro>(t2-t1).count();
+                selector.record(context, strategy, time / slots);
+                decision.calibrationTime += time;
+                assert(countNonConforming(referenceCopy, containerCopy, CompactionSelector::keepsOrder(strategy)) == 0);
+            }
+#ifndef NDEBUG
+            _scratchPool.release(referenceCopy);
+#endif
+            _scratchPool.release(containerCopy);
+            decision.reason = "calibrated";
+        }
+        bool explored = false;
+        decision.strategy = selector.choose(context, candidates, explored);
+        if(explored) decision.reason = "explored";
+        auto t1 = std::chrono::high_resolution_clock::now();
+        launchCompactor(decision.strategy, moleculeData, indices);
+        Kokkos::fence();
         auto t2 = std::chrono::high_resolution_clock::now();
-        if(display)
+        _scratchPool.release(indices);
+        decision.time = std::chrono::duration<double, std::micro>(t2-t1).count();
+        selector.record(context, decision.strategy, decision.time / slots);
+        if(display) std::cout << "compact: " << decision.to_string() << std::endl;
+        return decision;
+    }
+
+    // same with a selector owned by the container, it learns across calls on this container only
+    CompactionDecision compact(bool keepOrder, bool display = false)
+    {
+        return compact(_compactionSelector, keepOrder, display);
+    }
+
+    long countHoles() const
+    {
+        auto moleculeDataLocal(moleculeData);
+        const int cellSize = _cellSize;
+        long holes = 0;
+        Kokkos::parallel_reduce(_numCells, KOKKOS_LAMBDA(const int i, long& sum)
         {
-            std::cout << "Data compacted with onesweep_noOrder! Data:" << std::endl;
-            for (size_t i = 0; i < _numCells; i++)
+            for (int j = 0; j < cellSize; j++)
+                sum += (moleculeDataLocal(i,j) == 0);
+        }, holes);
+        return holes;
+    }
+
+    // compacts one scratch copy with reference and one with candidate, returns the number of cells whose rows differ slot for slot
+    long countMismatches(CompactionStrategy reference, CompactionStrategy candidate)
+    {
+        Kokkos::View<int**> referenceCopy = _scratchPool.acquire("copy", _numCells, _cellSize);
+        Kokkos::View<int**> candidateCopy = _scratchPool.acquire("copy", _numCells, _cellSize);
+        Kokkos::View<int**> indices = _scratchPool.acquire("indices", _numCells, _cellSize);
+        Kokkos::deep_copy(referenceCopy, moleculeData);
+        Kokkos::deep_copy(candidateCopy, moleculeData);
+        launchCompactor(reference, referenceCopy, indices);
+        launchCompactor(candidate, candidateCopy, indices);
+        Kokkos::fence();
+        long mismatches = 0;
+        for (int i = 0; i < _numCells; i++)
+        {
+            bool equal = true;
+            for (int j = 0; j < _cellSize; j++)
+                equal = equal && referenceCopy(i,j) == candidateCopy(i,j);
+            mismatches += !equal;
+        }
+        _scratchPool.release(indices);
+        _scratchPool.release(candidateCopy);
+        _scratchPool.release(referenceCopy);
+        return mismatches;
+    }
+
+    // compacts one scratch copy with every strategy and checks it against the generic pullback: the non-zero entries of every row are kept,
+    // holes end up at the tail and order-keeping strategies leave the rows in the same order, returns the number of (strategy, cell) pairs that fail
+    long verifyCompactors(bool display = false)
+    {
+        Kokkos::View<int**> referenceCopy = _scratchPool.acquire("copy", _numCells, _cellSize);
+        Kokkos::View<int**> candidateCopy = _scratchPool.acquire("copy", _numCells, _cellSize);
+        Kokkos::View<int**> indices = _scratchPool.acquire("indices", _numCells, _cellSize);
+        Kokkos::deep_copy(referenceCopy, moleculeData);
+        launchCompactor(CompactionStrategy::pullback, referenceCopy, indices);
+        Kokkos::fence();
+        // the reference itself keeps the entries of the uncompacted rows in their order
+        long failures = countNonConforming(moleculeData, referenceCopy, true);
+        if(display && failures > 0) std::cout << "pullback: " << failures << " cells lost, duplicated or reordered entries" << std::endl;
+        for (CompactionStrategy strategy : CompactionSelector::all())
+        {
+            Kokkos::deep_copy(candidateCopy, moleculeData);
+            launchCompactor(strategy, candidateCopy, indices);
+            Kokkos::fence();
+            const long failed = countNonConforming(referenceCopy, candidateCopy, CompactionSelector::keepsOrder(strategy));
+            if(display && failed > 0) std::cout << CompactionSelector::name(strategy) << ": " << failed << " cells differ from pullback" << std::endl;
+            failures += failed;
+        }
+        _scratchPool.release(indices);
+        _scratchPool.release(candidateCopy);
+        _scratchPool.release(referenceCopy);
+        return failures;
+    }
+
+    const AllocationStatistics& scratchAllocationStatistics() const { return _scratchPool.statistics(); }
+
+
+private:
+    // cells of candidate whose non-zero entries are not those of reference, that have a hole before an entry,
+    // or, with keepOrder, whose entries are not in the order of reference
+    long countNonConforming(const Kokkos::View<int**>& reference, const Kokkos::View<int**>& candidate, bool keepOrder) const
+    {
+        long failures = 0;
+        for (int i = 0; i < _numCells; i++)
+        {
+            std::vector<int> referenceRow, candidateRow;
+            bool holeAtTail = true;
+            for (int j = 0; j < _cellSize; j++)
             {
-                std::cout << "Cell #" << i << ": " ;
-                for (size_t j = 0; j < _cellSize; j++)
-                {
-                    std::cout << containerCopy(i,j) << " ";
-                }
-                std::cout << std::endl;
+                if(reference(i,j) != 0) referenceRow.push_back(reference(i,j));
+                if(candidate(i,j) != 0) candidateRow.push_back(candidate(i,j));
+                holeAtTail = holeAtTail && (j == 0 || candidate(i,j-1) != 0 || candidate(i,j) == 0);
             }
+            if(!keepOrder)
+            {
+                std::sort(referenceRow.begin(), referenceRow.end());
+                std::sort(candidateRow.begin(), candidateRow.end());
+            }
+            failures += !holeAtTail || referenceRow != candidateRow;
         }
+        return failures;
+    }
+
+    long timeOnCopy(CompactionStrategy strategy, bool display)
+    {
+        Kokkos::View<int**> containerCopy = _scratchPool.acquire("copy", _numCells, _cellSize);
+        Kokkos::View<int**> indices = _scratchPool.acquire("indices", _numCells, _cellSize);
+        Kokkos::deep_copy(containerCopy, moleculeData);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        launchCompactor(strategy, containerCopy, indices);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        if(display) displayCopy(CompactionSelector::name(strategy), containerCopy);
+        _scratchPool.release(indices);
+        _scratchPool.release(containerCopy);
         return std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count();
     }
 
+    void displayCopy(const std::string& name, const Kokkos::View<int**>& containerCopy) const
+    {
+        std::cout << "Data compacted with " << name << "! Data:" << std::endl;
+        for (size_t i = 0; i < _numCells; i++)
+        {
+            std::cout << "Cell #" << i << ": " ;
+            for (size_t j = 0; j < _cellSize; j++)
+            {
+                std::cout << containerCopy(i,j) << " ";
+            }
+            std::cout << std::endl;
+        }
+    }
 
-private:
     int _numCells;
     int _cellSize;
     std::mt19937 _gen;
     std::uniform_int_distribution<> _dis;
     Kokkos::View<int**> moleculeData;
+    // scratch copies the compactors work on, reused between calls
+    ViewPool<Kokkos::View<int**>> _scratchPool;
+    CompactionSelector _compactionSelector;
 };
\ No newline at end of file
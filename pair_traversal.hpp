@@ -0,0 +1,350 @@
+#pragma once
+
+#include <iostream>
+#include <chrono>
+#include <cassert>
+
+#include <Kokkos_Core.hpp>
+
+#include <molecule.hpp>
+#include <molecule_container.hpp>
+#include <index_converter.hpp>
+#include <cell_stencil.hpp>
+#include <cell_task_scheduler.hpp>
+
+// Lennard-Jones interaction, returns |F|/r so that F_i = forceOverDistance(r2) * (pos_i - pos_j)
+// templated on the value type so that the same expression serves scalar and SIMD traversals
+struct LennardJonesKernel
+{
+    LennardJonesKernel(double epsilon, double sigma) : epsilon24(24 * epsilon), sigma2(sigma * sigma) {}
+
+    template<class ValueType>
+    KOKKOS_INLINE_FUNCTION ValueType forceOverDistance(const ValueType& r2) const
+    {
+        const ValueType sr2 = ValueType(sigma2) / r2;
+        const ValueType sr6 = sr2 * sr2 * sr2;
+        return ValueType(epsilon24) * sr6 * (ValueType(2.0) * sr6 - ValueType(1.0)) / r2;
+    }
+
+    double epsilon24, sigma2;
+};
+
+// interior cells of a container and their 26 neighbours
+// with a ghost layer every neighbour of an interior cell exists, so the bounds test below is never taken
+struct CellNeighbourhood
+{
+    CellNeighbourhood(const MoleculeContainer& container) : numCellsPerDim(container.getNumCellsPerDim()), numCellsPerDimWithHalo(container.getNumCellsPerDimWithHalo()),
+        haloWidth(container.getHaloWidth()) {}
+
+    // index of the interior-th interior cell, its coordinates including the halo offset are written to c
+    KOKKOS_INLINE_FUNCTION int interiorCell(int interior, int c[3]) const
+    {
+        c[0] = interior % numCellsPerDim + haloWidth;
+        c[1] = (interior / numCellsPerDim) % numCellsPerDim + haloWidth;
+        c[2] = interior / (numCellsPerDim * numCellsPerDim) + haloWidth;
+        return c[0] + c[1] * numCellsPerDimWithHalo + c[2] * numCellsPerDimWithHalo * numCellsPerDimWithHalo;
+    }
+
+    // index of neighbour 0..26 (13 is the cell itself), -1 if it lies outside a grid without halo
+    KOKKOS_INLINE_FUNCTION int neighbourCell(const int c[3], int neighbour) const
+    {
+        const int nx = c[0] + neighbour % 3 - 1, ny = c[1] + (neighbour / 3) % 3 - 1, nz = c[2] + neighbour / 9 - 1;
+        if(haloWidth == 0 && (nx < 0 || ny < 0 || nz < 0 || nx >= numCellsPerDim || ny >= numCellsPerDim || nz >= numCellsPerDim))
+            return -1;
+        return nx + ny * numCellsPerDimWithHalo + nz * numCellsPerDimWithHalo * numCellsPerDimWithHalo;
+    }
+
+    int numCellsPerDim, numCellsPerDimWithHalo, haloWidth;
+};
+
+// full-shell traversal of all molecule pairs closer than the cutoff, one team per interior cell
+// every team only writes forces of its own cell, so cells need no colouring
+// periodic containers must have refreshed their halo, ghost cells then supply the periodic images
+// pairs at distance 0 (the molecule itself, or coinciding molecules) are skipped
+template<class PairKernel>
+class PairTraversal
+{
+public:
+    using ExecutionSpace = Kokkos::DefaultExecutionSpace;
+    using TeamPolicy = Kokkos::TeamPolicy<ExecutionSpace>;
+    using ScratchDoubles = Kokkos::View<double*, ExecutionSpace::scratch_memory_space, Kokkos::MemoryTraits<Kokkos::Unmanaged>>;
+
+    // the neighbourhood is the 27 surrounding cells, which only covers the cutoff for cells at least a cutoff wide, see HalfShellTraversal otherwise
+    PairTraversal(const MoleculeContainer& container, const PairKernel& kernel, double cutoff) : _container(container), _kernel(kernel), _cutoff2(cutoff * cutoff)
+    {
+        assert(container.getCellsPerCutoff() == 1);
+    }
+
+    // bytes of team scratch needed to stage a cell and its 26 neighbours
+    size_t scratchBytes() const
+    {
+        return 3 * ScratchDoubles::shmem_size(27 * _container.getCellSize());
+    }
+
+    // scratch level the staged traversal would use, -1 if the neighbourhood fits in neither
+    int scratchLevel() const
+    {
+        if(scratchBytes() <= static_cast<size_t>(TeamPolicy::scratch_size_max(0))) return 0;
+        if(scratchBytes() <= static_cast<size_t>(TeamPolicy::scratch_size_max(1))) return 1;
+        return -1;
+    }
+
+    // adds the pair forces to f of every molecule
+    void traverse(const ExecutionSpace& space = ExecutionSpace()) const
+    {
+        const int level = scratchLevel();
+        if(level >= 0)
+            traverseScratch(level, space);
+        else
+            traverseGlobal(space);
+    }
+
+    // stage positions of the cell and its neighbour stencil in team scratch once, run the pair loop from there
+    void traverseScratch(int level, const ExecutionSpace& space = ExecutionSpace()) const
+    {
+        auto moleculeData(_container.moleculeData);
+        auto linkedCellNumMolecules(_container.linkedCellNumMolecules);
+        const PairKernel kernel = _kernel;
+        const double cutoff2 = _cutoff2;
+        const CellNeighbourhood neighbourhood(_container);
+        const QuantisedPositions quantised = _container.quantisedPositions;
+        const int maxStaged = 27 * _container.getCellSize();
+
+        TeamPolicy policy(space, _container.getNumInteriorCells(), Kokkos::AUTO);
+        policy.set_scratch_size(level, Kokkos::PerTeam(scratchBytes()));
+        Kokkos::parallel_for("PairTraversal::scratch", policy, KOKKOS_LAMBDA(const TeamPolicy::member_type& team) {
+            int c[3];
+            const int index = neighbourhood.interiorCell(team.league_rank(), c);
+            ScratchDoubles x(team.team_scratch(level), maxStaged);
+            ScratchDoubles y(team.team_scratch(level), maxStaged);
+            ScratchDoubles z(team.team_scratch(level), maxStaged);
+
+            // own cell first so that its molecules are the first staged entries
+            int numStaged = 0;
+            for (int n = 0; n < 27; n++)
+            {
+                const int neighbourIndex = neighbourhood.neighbourCell(c, n == 0 ? 13 : (n <= 13 ? n - 1 : n));
+                if(neighbourIndex < 0)
+                    continue;
+                const int offset = numStaged;
+                Kokkos::parallel_for(Kokkos::TeamThreadRange(team, linkedCellNumMolecules(neighbourIndex)), [&](const int j) {
+                    double pos[3];
+                    quantised.read(moleculeData, neighbourIndex, j, pos);
+                    x(offset + j) = pos[0];
+                    y(offset + j) = pos[1];
+                    z(offset + j) = pos[2];
+                });
+                numStaged += linkedCellNumMolecules(neighbourIndex);
+            }
+            team.team_barrier();
+
+            Kokkos::parallel_for(Kokkos::TeamThreadRange(team, linkedCellNumMolecules(index)), [&](const int i) {
+                double fx = 0, fy = 0, fz = 0;
+                for (int j = 0; j < numStaged; j++)
+                {
+                    const double dx = x(i) - x(j), dy = y(i) - y(j), dz = z(i) - z(j);
+                    const double r2 = dx * dx + dy * dy + dz * dz;
+                    if(r2 < cutoff2 && r2 > 0)
+                    {
+                        const double f = kernel.forceOverDistance(r2);
+                        fx += f * dx;
+                        fy += f * dy;
+                        fz += f * dz;
+                    }
+                }
+                Molecule& m = moleculeData(index, i);
+                m.f[0] += fx;
+                m.f[1] += fy;
+                m.f[2] += fz;
+            });
+        });
+        space.fence();
+    }
+
+    // one team per interior cell reading neighbour positions from global memory, also a node of StepGraph
+    struct GlobalKernel
+    {
+        KOKKOS_INLINE_FUNCTION void operator()(const TeamPolicy::member_type& team) const
+        {
+            int c[3];
+            const int index = neighbourhood.interiorCell(team.league_rank(), c);
+            Kokkos::parallel_for(Kokkos::TeamThreadRange(team, linkedCellNumMolecules(index)), [&](const int i) {
+                Molecule& mi = moleculeData(index, i);
+                double posi[3];
+                quantised.read(moleculeData, index, i, posi);
+                double fx = 0, fy = 0, fz = 0;
+                for (int neighbour = 0; neighbour < 27; neighbour++)
+                {
+                    const int neighbourIndex = neighbourhood.neighbourCell(c, neighbour);
+                    if(neighbourIndex < 0)
+                        continue;
+                    for (int j = 0; j < linkedCellNumMolecules(neighbourIndex); j++)
+                    {
+                        double posj[3];
+                        quantised.read(moleculeData, neighbourIndex, j, posj);
+                        const double dx = posi[0] - posj[0], dy = posi[1] - posj[1], dz = posi[2] - posj[2];
+                        const double r2 = dx * dx + dy * dy + dz * dz;
+                        if(r2 < cutoff2 && r2 > 0)
+                        {
+                            const double f = kernel.forceOverDistance(r2);
+                            fx += f * dx;
+                            fy += f * dy;
+                            fz += f * dz;
+                        }
+                    }
+                }
+                mi.f[0] += fx;
+                mi.f[1] += fy;
+                mi.f[2] += fz;
+            });
+        }
+
+        MoleculeContainer::MoleculeView moleculeData;
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> linkedCellNumMolecules;
+        QuantisedPositions quantised;
+        CellNeighbourhood neighbourhood;
+        PairKernel kernel;
+        double cutoff2;
+    };
+
+    GlobalKernel globalKernel() const
+    {
+        return GlobalKernel{_container.moleculeData, _container.linkedCellNumMolecules, _container.quantisedPositions, CellNeighbourhood(_container), _kernel, _cutoff2};
+    }
+
+    // league of the global traversal, one team per interior cell
+    int numTeams() const { return _container.getNumInteriorCells(); }
+
+    // fallback for neighbourhoods that do not fit in scratch, reads neighbour positions from global memory
+    void traverseGlobal(const ExecutionSpace& space = ExecutionSpace()) const
+    {
+        Kokkos::parallel_for("PairTraversal::global", TeamPolicy(space, numTeams(), Kokkos::AUTO), globalKernel());
+        space.fence();
+    }
+
+private:
+    const MoleculeContainer& _container;
+    PairKernel _kernel;
+    double _cutoff2;
+};
+
+// half-shell traversal for cells of any width, typically cutoff/k, driven by a CellStencil generated from the cell geometry
+// every pair is evaluated once and its force added to both molecules, so kernels of one colour must not share a neighbour cell,
+// colours are launched one after the other on the same instance, cells of a colour run in parallel
+// periodic containers need a halo of at least the stencil reach, forces on ghost copies are folded back at the end,
+// which requires ghost forces to be cleared after the last refreshHalo
+template<class PairKernel>
+class HalfShellTraversal
+{
+public:
+    using ExecutionSpace = Kokkos::DefaultExecutionSpace;
+    using CellPolicy = MoleculeContainer::CellPolicy;
+
+    HalfShellTraversal(MoleculeContainer& container, const IndexConverter& indexConverter, const PairKernel& kernel, double cutoff) : _container(container), _kernel(kernel),
+        _cutoff2(cutoff * cutoff), _stencil(indexConverter.cellWidth(), cutoff)
+    {
+        assert(_container.getHaloWidth() == 0 || _container.getHaloWidth() >= _stencil.reach());
+    }
+
+    const CellStencil& stencil() const { return _stencil; }
+
+    // pairs of one interior cell with the cells its stencil reaches, forces are added to both molecules of a pair
+    struct CellKernel
+    {
+        KOKKOS_INLINE_FUNCTION void operator()(const int base) const
+        {
+            const int c[3] = {base % numCellsPerDimWithHalo, (base / numCellsPerDimWithHalo) % numCellsPerDimWithHalo, base / (numCellsPerDimWithHalo * numCellsPerDimWithHalo)};
+            for (int s = 0; s < stencilSize; s++)
+            {
+                const int nx = c[0] + offsets(s, 0), ny = c[1] + offsets(s, 1), nz = c[2] + offsets(s, 2);
+                if(haloWidth == 0 && (nx < 0 || ny < 0 || nz < 0 || nx >= numCellsPerDim || ny >= numCellsPerDim || nz >= numCellsPerDim))
+                    continue;
+                const int neighbour = nx + ny * numCellsPerDimWithHalo + nz * numCellsPerDimWithHalo * numCellsPerDimWithHalo;
+                for (int i = 0; i < linkedCellNumMolecules(base); i++)
+                {
+                    Molecule& mi = moleculeData(base, i);
+                    double posi[3];
+                    quantised.read(moleculeData, base, i, posi);
+                    double fx = 0, fy = 0, fz = 0;
+                    // the first stencil entry is the cell itself, whose pairs are taken once by j > i
+                    for (int j = (s == 0 ? i + 1 : 0); j < linkedCellNumMolecules(neighbour); j++)
+                    {
+                        Molecule& mj = moleculeData(neighbour, j);
+                        double posj[3];
+                        quantised.read(moleculeData, neighbour, j, posj);
+                        const double dx = posi[0] - posj[0], dy = posi[1] - posj[1], dz = posi[2] - posj[2];
+                        const double r2 = dx * dx + dy * dy + dz * dz;
+                        if(r2 < cutoff2 && r2 > 0)
+                        {
+                            const double f = kernel.forceOverDistance(r2);
+                            fx += f * dx;
+                            fy += f * dy;
+                            fz += f * dz;
+                            mj.f[0] -= f * dx;
+                            mj.f[1] -= f * dy;
+                            mj.f[2] -= f * dz;
+                        }
+                    }
+                    mi.f[0] += fx;
+                    mi.f[1] += fy;
+                    mi.f[2] += fz;
+                }
+            }
+        }
+
+        MoleculeContainer::MoleculeView moleculeData;
+        Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> linkedCellNumMolecules;
+        Kokkos::View<int*[3], Kokkos::LayoutRight, Kokkos::SharedSpace> offsets;
+        QuantisedPositions quantised;
+        PairKernel kernel;
+        double cutoff2;
+        int stencilSize, numCellsPerDim, numCellsPerDimWithHalo, haloWidth;
+    };
+
+    CellKernel cellKernel() const
+    {
+        return CellKernel{_container.moleculeData, _container.linkedCellNumMolecules, _stencil.offsets, _container.quantisedPositions, _kernel, _cutoff2,
+            _stencil.size(), _container.getNumCellsPerDim(), _container.getNumCellsPerDimWithHalo(), _container.getHaloWidth()};
+    }
+
+    // adds the pair forces to f of every molecule
+    void traverse(const ExecutionSpace& space = ExecutionSpace()) const
+    {
+        const CellKernel cellKernel = this->cellKernel();
+        const int numCellsPerDim = _container.getNumCellsPerDim();
+        const int numCellsPerDimWithHalo = _container.getNumCellsPerDimWithHalo();
+        const int haloWidth = _container.getHaloWidth();
+        const int stride[3] = {_stencil.colourStride(0), _stencil.colourStride(1), _stencil.colourStride(2)};
+
+        for (int colour = 0; colour < _stencil.numColours(); colour++)
+        {
+            const int start[3] = {colour % stride[0], (colour / stride[0]) % stride[1], colour / (stride[0] * stride[1])};
+            const int length[3] = {(numCellsPerDim - start[0] + stride[0] - 1) / stride[0], (numCellsPerDim - start[1] + stride[1] - 1) / stride[1], (numCellsPerDim - start[2] + stride[2] - 1) / stride[2]};
+            if(length[0] * length[1] * length[2] == 0)
+                continue;
+            Kokkos::parallel_for("HalfShellTraversal", CellPolicy(space, 0, length[0] * length[1] * length[2]), KOKKOS_LAMBDA(const int b) {
+                const int c[3] = {haloWidth + start[0] + stride[0] * (b % length[0]), haloWidth + start[1] + stride[1] * ((b / length[0]) % length[1]),
+                    haloWidth + start[2] + stride[2] * (b / (length[0] * length[1]))};
+                cellKernel(c[0] + c[1] * numCellsPerDimWithHalo + c[2] * numCellsPerDimWithHalo * numCellsPerDimWithHalo);
+            });
+        }
+        space.fence();
+        _container.foldHaloForces(space);
+    }
+
+    // same forces, cells run as soon as the scheduler owns their stencil instead of colour by colour,
+    // the scheduler has to come from CellTaskScheduler::forStencil with this traversal's stencil and the container's geometry
+    void traverse(const CellTaskScheduler& scheduler) const
+    {
+        assert(scheduler.numTasks() == _container.getNumCellsPerDim() * _container.getNumCellsPerDim() * _container.getNumCellsPerDim());
+        const CellKernel cellKernel = this->cellKernel();
+        scheduler.run([&](const int base) { cellKernel(base); });
+        _container.foldHaloForces();
+    }
+
+private:
+    MoleculeContainer& _container;
+    PairKernel _kernel;
+    double _cutoff2;
+    CellStencil _stencil;
+};
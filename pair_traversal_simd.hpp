@@ -0,0 +1,151 @@
+#pragma once
+
+#include <iostream>
+#include <cassert>
+
+#include <Kokkos_Core.hpp>
+#include <Kokkos_SIMD.hpp>
+
+#include <molecule.hpp>
+#include <molecule_container.hpp>
+#include <pair_traversal.hpp>
+
+// explicitly vectorised variant of PairTraversal, PairTraversal stays the scalar reference
+// the vector width is the native one of the enabled architecture (4 doubles for AVX2, 8 for AVX-512, 1 without SIMD support)
+// staged neighbourhoods are padded to a multiple of the width with far-away positions, padded and out-of-cutoff lanes are masked
+template<class PairKernel>
+class SimdPairTraversal
+{
+public:
+    using ExecutionSpace = Kokkos::DefaultExecutionSpace;
+    using TeamPolicy = Kokkos::TeamPolicy<ExecutionSpace>;
+    using ScratchDoubles = Kokkos::View<double*, ExecutionSpace::scratch_memory_space, Kokkos::MemoryTraits<Kokkos::Unmanaged>>;
+    using SimdType = Kokkos::Experimental::native_simd<double>;
+    using MaskType = typename SimdType::mask_type;
+    static constexpr int width = SimdType::size();
+
+    // same 27-cell neighbourhood as PairTraversal, so cells have to be at least a cutoff wide
+    SimdPairTraversal(const MoleculeContainer& container, const PairKernel& kernel, double cutoff) : _container(container), _kernel(kernel), _cutoff(cutoff)
+    {
+        assert(container.getCellsPerCutoff() == 1);
+    }
+
+    // every neighbour cell is padded separately, so each of the 27 may add up to width - 1 entries
+    int maxStaged() const
+    {
+        return 27 * ((_container.getCellSize() + width - 1) / width) * width;
+    }
+
+    size_t scratchBytes() const
+    {
+        return 3 * ScratchDoubles::shmem_size(maxStaged());
+    }
+
+    int scratchLevel() const
+    {
+        if(scratchBytes() <= static_cast<size_t>(TeamPolicy::scratch_size_max(0))) return 0;
+        if(scratchBytes() <= static_cast<size_t>(TeamPolicy::scratch_size_max(1))) return 1;
+        return -1;
+    }
+
+    // adds the pair forces to f of every molecule, falls back to the scalar global traversal if a neighbourhood does not fit
+    void traverse(const ExecutionSpace& space = ExecutionSpace()) const
+    {
+        const int level = scratchLevel();
+        if(level < 0)
+        {
+            PairTraversal<PairKernel>(_container, _kernel, _cutoff).traverseGlobal(space);
+            return;
+        }
+
+        auto moleculeData(_container.moleculeData);
+        auto linkedCellNumMolecules(_container.linkedCellNumMolecules);
+        const PairKernel kernel = _kernel;
+        const double cutoff2 = _cutoff * _cutoff;
+        const CellNeighbourhood neighbourhood(_container);
+        const QuantisedPositions quantised = _container.quantisedPositions;
+        const int stagedCapacity = maxStaged();
+
+        TeamPolicy policy(space, _container.getNumInteriorCells(), Kokkos::AUTO);
+        policy.set_scratch_size(level, Kokkos::PerTeam(scratchBytes()));
+        Kokkos::parallel_for("SimdPairTraversal", policy, KOKKOS_LAMBDA(const TeamPolicy::member_type& team) {
+            int c[3];
+            const int index = neighbourhood.interiorCell(team.league_rank(), c);
+            ScratchDoubles x(team.team_scratch(level), stagedCapacity);
+            ScratchDoubles y(team.team_scratch(level), stagedCapacity);
+            ScratchDoubles z(team.team_scratch(level), stagedCapacity);
+
+            // own cell first, its molecules are the first staged entries
+            int numStaged = 0;
+            for (int n = 0; n < 27; n++)
+            {
+                const int neighbourIndex = neighbourhood.neighbourCell(c, n == 0 ? 13 : (n <= 13 ? n - 1 : n));
+                if(neighbourIndex < 0)
+                    continue;
+                const int count = linkedCellNumMolecules(neighbourIndex);
+                const int padded = ((count + width - 1) / width) * width;
+                const int offset = numStaged;
+                Kokkos::parallel_for(Kokkos::TeamThreadRange(team, padded), [&](const int j) {
+                    if(j < count)
+                    {
+                        double pos[3];
+                        quantised.read(moleculeData, neighbourIndex, j, pos);
+                        x(offset + j) = pos[0];
+                        y(offset + j) = pos[1];
+                        z(offset + j) = pos[2];
+                    }
+                    else
+                    {
+                        x(offset + j) = farAway;
+                        y(offset + j) = farAway;
+                        z(offset + j) = farAway;
+                    }
+                });
+                numStaged += padded;
+            }
+            team.team_barrier();
+
+            Kokkos::parallel_for(Kokkos::TeamThreadRange(team, linkedCellNumMolecules(index)), [&](const int i) {
+                const SimdType xi(x(i)), yi(y(i)), zi(z(i));
+                SimdType fx(0.0), fy(0.0), fz(0.0);
+                for (int j = 0; j < numStaged; j += width)
+                {
+                    SimdType xj, yj, zj;
+                    xj.copy_from(x.data() + j, Kokkos::Experimental::simd_flag_default);
+                    yj.copy_from(y.data() + j, Kokkos::Experimental::simd_flag_default);
+                    zj.copy_from(z.data() + j, Kokkos::Experimental::simd_flag_default);
+                    const SimdType dx = xi - xj, dy = yi - yj, dz = zi - zj;
+                    SimdType r2 = dx * dx + dy * dy + dz * dz;
+                    const MaskType active = (r2 < SimdType(cutoff2)) && (r2 > SimdType(0.0));
+                    // inactive lanes get a harmless distance so the kernel never divides by zero
+                    Kokkos::Experimental::where(!active, r2) = SimdType(1.0);
+                    SimdType f = kernel.forceOverDistance(r2);
+                    Kokkos::Experimental::where(!active, f) = SimdType(0.0);
+                    fx += f * dx;
+                    fy += f * dy;
+                    fz += f * dz;
+                }
+                double fxLanes[width], fyLanes[width], fzLanes[width];
+                fx.copy_to(fxLanes, Kokkos::Experimental::simd_flag_default);
+                fy.copy_to(fyLanes, Kokkos::Experimental::simd_flag_default);
+                fz.copy_to(fzLanes, Kokkos::Experimental::simd_flag_default);
+                Molecule& m = moleculeData(index, i);
+                for (int l = 0; l < width; l++)
+                {
+                    m.f[0] += fxLanes[l];
+                    m.f[1] += fyLanes[l];
+                    m.f[2] += fzLanes[l];
+                }
+            });
+        });
+        space.fence();
+    }
+
+private:
+    // padding position, squared distances stay finite but far beyond any cutoff
+    static constexpr double farAway = 1e100;
+
+    const MoleculeContainer& _container;
+    PairKernel _kernel;
+    double _cutoff;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+
+#include <Kokkos_Core.hpp>
+
+// splits the default execution space into a primary and a secondary partition so that independent phases of a step overlap,
+// e.g. the force traversal on the primary partition while output packing runs on the secondary one
+// phases synchronise through fences of their own instance only, never through a global Kokkos::fence
+// host backends such as OpenMP execute a kernel on the launching thread, so every partition is driven from its own host thread
+class PartitionedScheduler
+{
+public:
+    using ExecutionSpace = Kokkos::DefaultExecutionSpace;
+
+    PartitionedScheduler(double primaryWeight = 3, double secondaryWeight = 1)
+        : _instances(Kokkos::Experimental::partition_space(ExecutionSpace(), std::vector<double>{primaryWeight, secondaryWeight})) {}
+
+    const ExecutionSpace& primary() const { return _instances[0]; }
+    const ExecutionSpace& secondary() const { return _instances[1]; }
+
+    // runs primaryPhase(primary()) and secondaryPhase(secondary()) concurrently and returns once both instances are fenced
+    // the phases must not write data the other one reads or writes
+    template<class PrimaryPhase, class SecondaryPhase>
+    void overlap(const PrimaryPhase& primaryPhase, const SecondaryPhase& secondaryPhase) const
+    {
+        std::thread secondaryThread([&]() {
+            secondaryPhase(_instances[1]);
+            _instances[1].fence();
+        });
+        primaryPhase(_instances[0]);
+        _instances[0].fence();
+        secondaryThread.join();
+    }
+
+private:
+    std::vector<ExecutionSpace> _instances;
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+
+#include <Kokkos_Core.hpp>
+
+// optional fixed-point storage of molecule positions relative to the origin of their cell, 16 or 32 bits per coordinate
+// codes span [-cellWidth, 2*cellWidth) around the origin, so molecules that moved by less than a cell since the last sort stay representable,
+// within that range the error per coordinate is at most resolution()/2, positions beyond it are clamped to its ends
+// codes are invariant under shifts by whole domains, so ghost cells copy them unchanged
+// a default constructed store holds nothing, positions then live in Molecule::pos
+struct QuantisedPositions
+{
+    using Codes16 = Kokkos::View<uint16_t**[3], Kokkos::LayoutRight, Kokkos::SharedSpace>;
+    using Codes32 = Kokkos::View<uint32_t**[3], Kokkos::LayoutRight, Kokkos::SharedSpace>;
+
+    QuantisedPositions() : bits(0), cellWidth(0), numCellsPerDimWithHalo(0), haloWidth(0) {}
+    QuantisedPositions(int bits, double cellWidth, int numCellsPerDimWithHalo, int haloWidth, int numCells, int cellSize) : bits(bits), cellWidth(cellWidth),
+        numCellsPerDimWithHalo(numCellsPerDimWithHalo), haloWidth(haloWidth)
+    {
+        assert(bits == 16 || bits == 32);
+        if(bits == 16)
+            codes16 = Codes16(Kokkos::view_alloc(Kokkos::WithoutInitializing, "positionCodes16"), numCells, cellSize);
+        else
+            codes32 = Codes32(Kokkos::view_alloc(Kokkos::WithoutInitializing, "positionCodes32"), numCells, cellSize);
+    }
+
+    // same format with room for cellSize slots per cell, codes are not copied
+    QuantisedPositions resized(int numCells, int cellSize) const
+    {
+        return QuantisedPositions(bits, cellWidth, numCellsPerDimWithHalo, haloWidth, numCells, cellSize);
+    }
+
+    KOKKOS_INLINE_FUNCTION bool enabled() const { return bits != 0; }
+    KOKKOS_INLINE_FUNCTION double maxCode() const { return bits == 16 ? 65535.0 : 4294967295.0; }
+    // distance between neighbouring codes
+    KOKKOS_INLINE_FUNCTION double resolution() const { return 3 * cellWidth / maxCode(); }
+    // bytes of position data per molecule
+    KOKKOS_INLINE_FUNCTION int bytesPerMolecule() const { return 3 * bits / 8; }
+
+    KOKKOS_INLINE_FUNCTION double cellOrigin(int cellIdx, int d) const
+    {
+        const int coordinate = d == 0 ? cellIdx % numCellsPerDimWithHalo : (d == 1 ? (cellIdx / numCellsPerDimWithHalo) % numCellsPerDimWithHalo : cellIdx / (numCellsPerDimWithHalo * numCellsPerDimWithHalo));
+        return (coordinate - haloWidth) * cellWidth;
+    }
+
+    KOKKOS_INLINE_FUNCTION void encode(int cellIdx, int slot, const double pos[3]) const
+    {
+        for (int d = 0; d < 3; d++)
+        {
+            double scaled = (pos[d] - cellOrigin(cellIdx, d) + cellWidth) / (3 * cellWidth) * maxCode() + 0.5;
+            scaled = scaled < 0 ? 0 : (scaled > maxCode() ? maxCode() : scaled);
+            if(bits == 16)
+                codes16(cellIdx, slot, d) = static_cast<uint16_t>(scaled);
+            else
+                codes32(cellIdx, slot, d) = static_cast<uint32_t>(scaled);
+        }
+    }
+
+    KOKKOS_INLINE_FUNCTION void decode(int cellIdx, int slot, double pos[3]) const
+    {
+        for (int d = 0; d < 3; d++)
+        {
+            const double code = bits == 16 ? static_cast<double>(codes16(cellIdx, slot, d)) : static_cast<double>(codes32(cellIdx, slot, d));
+            pos[d] = cellOrigin(cellIdx, d) - cellWidth + code * resolution();
+        }
+    }
+
+    // copies codes between slots, the position keeps its offset to the cell origin
+    KOKKOS_INLINE_FUNCTION void copy(int fromCell, int fromSlot, int toCell, int toSlot) const
+    {
+        for (int d = 0; d < 3; d++)
+        {
+            if(bits == 16)
+                codes16(toCell, toSlot, d) = codes16(fromCell, fromSlot, d);
+            else
+                codes32(toCell, toSlot, d) = codes32(fromCell, fromSlot, d);
+        }
+    }
+
+    // copies the codes of one slot from another store of the same format, e.g. the one replaced by resized
+    KOKKOS_INLINE_FUNCTION void copy(const QuantisedPositions& source, int cellIdx, int slot) const
+    {
+        for (int d = 0; d < 3; d++)
+        {
+            if(bits == 16)
+                codes16(cellIdx, slot, d) = source.codes16(cellIdx, slot, d);
+            else
+                codes32(cellIdx, slot, d) = source.codes32(cellIdx, slot, d);
+        }
+    }
+
+    // position of the molecule in (cellIdx, slot), from the codes when enabled and from the molecule otherwise
+    template<class MoleculeViewType>
+    KOKKOS_INLINE_FUNCTION void read(const MoleculeViewType& moleculeData, int cellIdx, int slot, double pos[3]) const
+    {
+        if(enabled())
+            decode(cellIdx, slot, pos);
+        else
+            for (int d = 0; d < 3; d++)
+                pos[d] = moleculeData(cellIdx, slot).pos[d];
+    }
+
+    template<class MoleculeViewType>
+    KOKKOS_INLINE_FUNCTION void write(const MoleculeViewType& moleculeData, int cellIdx, int slot, const double pos[3]) const
+    {
+        if(enabled())
+            encode(cellIdx, slot, pos);
+        else
+            for (int d = 0; d < 3; d++)
+                moleculeData(cellIdx, slot).pos[d] = pos[d];
+    }
+
+    int bits;
+    double cellWidth;
+    int numCellsPerDimWithHalo, haloWidth;
+    Codes16 codes16;
+    Codes32 codes32;
+};
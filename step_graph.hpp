@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cassert>
+
+#include <Kokkos_Core.hpp>
+#include <Kokkos_Graph.hpp>
+
+#include <molecule_container.hpp>
+#include <index_converter.hpp>
+#include <pair_traversal.hpp>
+
+// one time step of a container built once as a Kokkos graph and re-submitted every step, so that the kernels of a step cost a single submission and fence
+// edges only where data flows: the sort colours in sequence, then refreshHalo (periodic only), clearForces and the force traversal
+// packing of positions needs a scan for its offsets, which graphs cannot hold as a node, so submit launches it on the graph's execution space
+// once the graph is done
+// nodes hold the container's Views by value, so the graph has to be rebuilt after every reallocation (grow, reserve, shrink_to_fit) and after
+// enabling or disabling quantised positions or the id index, submit asserts that the container's generation has not changed since
+template<class PairKernel>
+class StepGraph
+{
+public:
+    using ExecutionSpace = MoleculeContainer::ExecutionSpace;
+    using CellPolicy = MoleculeContainer::CellPolicy;
+    using TeamPolicy = Kokkos::TeamPolicy<ExecutionSpace>;
+    using GraphNode = Kokkos::Experimental::GraphNodeRef<ExecutionSpace>;
+
+    StepGraph(const MoleculeContainer& container, const IndexConverter& indexConverter, const PairTraversal<PairKernel>& traversal,
+        const Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace>& offsets, const Kokkos::View<double*[4], Kokkos::LayoutRight, Kokkos::SharedSpace>& buffer,
+        const ExecutionSpace& space = ExecutionSpace()) : _container(container), _offsets(offsets), _buffer(buffer), _capturedGeneration(container.getGeneration()), _numKernels(0),
+        _graph(build(container, indexConverter, traversal, space, _numKernels)) {}
+
+    // runs sort, halo refresh, force computation and packing of one step, returns once the graph's execution space is fenced
+    void submit() const
+    {
+        assert(_container.getGeneration() == _capturedGeneration);
+        _graph.submit();
+        _container.packPositions(_offsets, _buffer, _graph.get_execution_space());
+    }
+
+    // kernels captured in the graph, each of which would otherwise be its own launch, packing is not among them
+    int numKernels() const { return _numKernels; }
+
+private:
+    static Kokkos::Experimental::Graph<ExecutionSpace> build(const MoleculeContainer& container, const IndexConverter& indexConverter, const PairTraversal<PairKernel>& traversal,
+        const ExecutionSpace& space, int& numKernels)
+    {
+        return Kokkos::Experimental::create_graph(space, [&](const auto& root) {
+            GraphNode sorted = root;
+            for (int colour = 0; colour < container.numSortColours(); colour++)
+            {
+                const MoleculeContainer::SortColourKernel kernel = container.sortColourKernel(indexConverter, colour);
+                sorted = sorted.then_parallel_for("StepGraph::sort", CellPolicy(0, kernel.length()), kernel);
+                numKernels++;
+            }
+
+            GraphNode forces = sorted;
+            if(container.getHaloWidth() > 0)
+            {
+                forces = forces.then_parallel_for("StepGraph::refreshHalo", CellPolicy(0, container.getNumCells()), container.refreshHaloKernel(indexConverter));
+                numKernels++;
+            }
+            forces = forces.then_parallel_for("StepGraph::clearForces", CellPolicy(0, container.getNumCells()), container.clearForcesKernel());
+            forces.then_parallel_for("StepGraph::forces", TeamPolicy(traversal.numTeams(), Kokkos::AUTO), traversal.globalKernel());
+            numKernels += 2;
+        });
+    }
+
+    const MoleculeContainer& _container;
+    Kokkos::View<int*, Kokkos::LayoutRight, Kokkos::SharedSpace> _offsets;
+    Kokkos::View<double*[4], Kokkos::LayoutRight, Kokkos::SharedSpace> _buffer;
+    int _capturedGeneration;
+    int _numKernels;
+    Kokkos::Experimental::Graph<ExecutionSpace> _graph;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Kokkos_Core.hpp>
+
+struct AllocationStatistics
+{
+    size_t allocations = 0;
+    size_t reuses = 0;
+    size_t bytesAllocated = 0;
+    size_t bytesPooled = 0;
+
+    std::string to_string() const
+    {
+        std::stringstream to_ret;
+        to_ret << "allocations: " << allocations << " (" << bytesAllocated << " bytes), reused: " << reuses << ", pooled: " << bytesPooled << " bytes";
+        return to_ret.str();
+    }
+};
+
+// hands out Views of a fixed type, released Views are kept and handed out again for requests with identical extents
+// memory is neither initialised on allocation nor cleared on reuse
+template<class ViewType>
+class ViewPool
+{
+public:
+    ViewPool(size_t maxPooledViews = 2) : _maxPooledViews(maxPooledViews) {}
+
+    template<class... Extents>
+    ViewType acquire(const std::string& label, Extents... extents)
+    {
+        const size_t requested[] = {static_cast<size_t>(extents)...};
+        for (size_t i = 0; i < _pooled.size(); i++)
+        {
+            bool match = true;
+            for (size_t d = 0; d < sizeof...(Extents); d++)
+                match = match && _pooled[i].extent(d) == requested[d];
+            if(match)
+            {
+                ViewType view = _pooled[i];
+                _statistics.bytesPooled -= bytes(view);
+                _pooled.erase(_pooled.begin() + i);
+                _statistics.reuses++;
+                return view;
+            }
+        }
+        ViewType view(Kokkos::view_alloc(Kokkos::WithoutInitializing, label), extents...);
+        _statistics.allocations++;
+        _statistics.bytesAllocated += bytes(view);
+        return view;
+    }
+
+    // takes the View away from the caller, it is only kept if nobody else still references it
+    void release(ViewType& view)
+    {
+        ViewType released = view;
+        view = ViewType();
+        if(released.use_count() != 1 || _maxPooledViews == 0)
+            return;
+        if(_pooled.size() == _maxPooledViews)
+        {
+            _statistics.bytesPooled -= bytes(_pooled.front());
+            _pooled.erase(_pooled.begin());
+        }
+        _statistics.bytesPooled += bytes(released);
+        _pooled.push_back(released);
+    }
+
+    // drops the pooled Views for which discard(view) is true
+    template<class Predicate>
+    void discardIf(const Predicate& discard)
+    {
+        for (size_t i = 0; i < _pooled.size();)
+        {
+            if(discard(_pooled[i]))
+            {
+                _statistics.bytesPooled -= bytes(_pooled[i]);
+                _pooled.erase(_pooled.begin() + i);
+            }
+            else
+                i++;
+        }
+    }
+
+    // drops all pooled Views so that their memory is returned
+    void clear()
+    {
+        _pooled.clear();
+        _statistics.bytesPooled = 0;
+    }
+
+    const AllocationStatistics& statistics() const { return _statistics; }
+
+private:
+    static size_t bytes(const ViewType& view) { return view.size() * sizeof(typename ViewType::value_type); }
+
+    size_t _maxPooledViews;
+    std::vector<ViewType> _pooled;
+    AllocationStatistics _statistics;
+};